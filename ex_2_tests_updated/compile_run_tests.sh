@@ -13,6 +13,32 @@ g++ -std=c++11 uthreads.h uthreads.cpp utils.cpp utils.h tests/jona6.cpp -o test
 #g++ -std=c++11 uthreads.h uthreads.cpp utils.cpp utils.h tests/test4.in.cpp -o tests/drive4
 #g++ -std=c++11 uthreads.h uthreads.cpp utils.cpp utils.h tests/test5_no_out.cpp -o tests/drive5
 #g++ -std=c++11 uthreads.h uthreads.cpp utils.cpp utils.h tests/test6_no_out.cpp -o tests/drive6
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test7_preempt_registers.cpp -o tests/drive7
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test8_self_terminate.cpp -o tests/drive8
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test9_no_alloc_tick.cpp -o tests/drive9
+g++ -std=c++11 -Wl,-z,now uthreads.h uthreads.cpp tests/test10_socket_io.cpp -o tests/drive10
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test11_file_io.cpp -o tests/drive11
+g++ -std=c++11 -Wl,-z,now uthreads.h uthreads.cpp uthreads_wrap.cpp tests/test12_interpose.cpp -o tests/drive12 -ldl
+g++ -std=c++11 -Wl,-z,now uthreads.h uthreads.cpp uthreads_pthread.cpp tests/test13_pthread_shim.cpp -o tests/drive13 -ldl
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test14_sleep_deadline.cpp -o tests/drive14
+g++ -std=c++11 -Wl,-z,now uthreads.h uthreads.cpp tests/test15_clock_source.cpp -o tests/drive15
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test16_timer_slack.cpp -o tests/drive16
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test17_callback_timers.cpp -o tests/drive17
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test18_task_group.cpp -o tests/drive18
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test19_algorithms.cpp -o tests/drive19
+g++ -std=c++11 -O2 uthreads.h uthreads.cpp tests/bench_algorithms.cpp -o tests/bench_algorithms
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test20_barrier_latch.cpp -o tests/drive20
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test21_rwlock.cpp -o tests/drive21
+g++ -std=c++11 -O2 uthreads.h uthreads.cpp tests/bench_locks.cpp -o tests/bench_locks
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test22_address_wait.cpp -o tests/drive22
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test23_priority_inheritance.cpp -o tests/drive23
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test24_select.cpp -o tests/drive24
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test25_generators.cpp -o tests/drive25
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test26_posted_tasks.cpp -o tests/drive26
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test27_executor.cpp -o tests/drive27
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test28_futures.cpp -o tests/drive28
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test29_actors.cpp -o tests/drive29
+g++ -std=c++11 uthreads.h uthreads.cpp tests/test30_stack_painting.cpp -o tests/drive30
 
 chmod -R 700 .
 
@@ -46,4 +72,55 @@ echo ""
 #drive5
 #echo "Running drive6"
 #drive6
+echo "Running drive7"
+./drive7
+echo "Running drive8"
+./drive8
+echo "Running drive9"
+./drive9
+echo "Running drive10"
+./drive10
+echo "Running drive11"
+./drive11
+echo "Running drive12"
+./drive12
+echo "Running drive13"
+./drive13
+UTHREADS_PTHREAD_SHIM=0 ./drive13
+echo "Running drive14"
+./drive14
+echo "Running drive15"
+./drive15
+echo "Running drive16"
+./drive16
+echo "Running drive17"
+./drive17
+echo "Running drive18"
+./drive18
+echo "Running drive19"
+./drive19
+./bench_algorithms 7
+echo "Running drive20"
+./drive20
+echo "Running drive21"
+./drive21
+./bench_locks
+echo "Running drive22"
+./drive22
+echo "Running drive23"
+./drive23
+echo "Running drive24"
+./drive24
+echo "Running drive25"
+./drive25
+echo "Running drive26"
+./drive26
+echo "Running drive27"
+./drive27
+echo "Running drive28"
+./drive28
+echo "Running drive29"
+./drive29
+echo "Running drive30"
+./drive30
 
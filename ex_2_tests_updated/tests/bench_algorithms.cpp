@@ -0,0 +1,114 @@
+/**********************************************
+ * Benchmark: parallel algorithms against std
+ *
+ * times uthread::sort against std::sort, and reduce, inclusive_scan
+ * and transform against std::accumulate, std::partial_sum and
+ * std::transform, on random ints from 10^4 up to 10^8 elements
+ * (or 10^argv[1]; 10^8 needs about 1.2 GB). Build it with -O2:
+ * the serial kernels are meant to be vectorized.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "../uthreads_algorithms.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 10000
+#define MIN_EXPONENT 4
+#define MAX_EXPONENT 8
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_exponent = argc > 1 ? atoi(argv[1]) : MAX_EXPONENT;
+    uthread_init(QUANTUM_USECS);
+    srand(40);
+
+    printf("%10s %-15s %12s %12s %8s\n", "elements", "algorithm", "std ms", "uthread ms", "ratio");
+    long n = 1;
+    for (int exponent = 0; exponent <= max_exponent; exponent++, n *= 10)
+    {
+        if (exponent < MIN_EXPONENT)
+        {
+            continue;
+        }
+        std::vector<int> data(n);
+        for (long i = 0; i < n; i++)
+        {
+            data[i] = rand();
+        }
+
+        std::vector<int> by_std = data, by_uthread = data;
+        double start = now_ms();
+        std::sort(by_std.begin(), by_std.end());
+        double std_ms = now_ms() - start;
+        start = now_ms();
+        uthread::sort(by_uthread.data(), by_uthread.data() + n);
+        double uthread_ms = now_ms() - start;
+        if (by_std != by_uthread)
+        {
+            error("sort results differ");
+        }
+        printf("%10ld %-15s %12.2f %12.2f %8.2f\n", n, "sort", std_ms, uthread_ms, uthread_ms / std_ms);
+
+        start = now_ms();
+        long long std_sum = std::accumulate(data.begin(), data.end(), 0LL);
+        std_ms = now_ms() - start;
+        std::vector<long long> wide(data.begin(), data.end());
+        start = now_ms();
+        long long uthread_sum = uthread::reduce(wide.data(), wide.data() + n, 0LL);
+        uthread_ms = now_ms() - start;
+        if (std_sum != uthread_sum)
+        {
+            error("reduce results differ");
+        }
+        printf("%10ld %-15s %12.2f %12.2f %8.2f\n", n, "reduce", std_ms, uthread_ms, uthread_ms / std_ms);
+
+        std::vector<long long> std_scan(n), uthread_scan(n);
+        start = now_ms();
+        std::partial_sum(wide.begin(), wide.end(), std_scan.begin());
+        std_ms = now_ms() - start;
+        start = now_ms();
+        uthread::inclusive_scan(wide.data(), wide.data() + n, uthread_scan.data());
+        uthread_ms = now_ms() - start;
+        if (std_scan != uthread_scan)
+        {
+            error("inclusive_scan results differ");
+        }
+        printf("%10ld %-15s %12.2f %12.2f %8.2f\n", n, "inclusive_scan", std_ms, uthread_ms, uthread_ms / std_ms);
+
+        start = now_ms();
+        std::transform(data.begin(), data.end(), by_std.begin(), [](int x) { return x * 3 + 1; });
+        std_ms = now_ms() - start;
+        start = now_ms();
+        uthread::transform(data.data(), data.data() + n, by_uthread.data(), [](int x) { return x * 3 + 1; });
+        uthread_ms = now_ms() - start;
+        if (by_std != by_uthread)
+        {
+            error("transform results differ");
+        }
+        printf("%10ld %-15s %12.2f %12.2f %8.2f\n", n, "transform", std_ms, uthread_ms, uthread_ms / std_ms);
+        fflush(stdout);
+    }
+    uthread_terminate(0);
+}
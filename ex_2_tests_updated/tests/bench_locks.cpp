@@ -0,0 +1,132 @@
+/**********************************************
+ * Benchmark: lock contention
+ *
+ * THREADS threads do OPERATIONS critical sections each over a shared
+ * table, a tenth of them writes, under a mutex and the
+ * reader-writer lock, with a critical section long enough for the
+ * tick to preempt holders now and then. Prints the time and the
+ * operations per millisecond of every lock.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define THREADS 16
+#define OPERATIONS 20000
+#define WRITE_EVERY 10
+#define TABLE_SIZE 64
+
+enum lock_kind {MUTEX, RWLOCK};
+
+lock_kind kind;
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+uthread_rwlock_t rwlock = UTHREAD_RWLOCK_INITIALIZER;
+volatile long table[TABLE_SIZE];
+volatile long checksum = 0;
+volatile int finished = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+void lock(bool write)
+{
+    if (kind == RWLOCK)
+    {
+        write ? uthread_rwlock_wrlock(&rwlock) : uthread_rwlock_rdlock(&rwlock);
+    }
+    else
+    {
+        uthread_mutex_lock(&mutex);
+    }
+}
+
+void unlock()
+{
+    if (kind == RWLOCK)
+    {
+        uthread_rwlock_unlock(&rwlock);
+    }
+    else
+    {
+        uthread_mutex_unlock(&mutex);
+    }
+}
+
+void worker()
+{
+    long sum = 0;
+    for (int i = 0; i < OPERATIONS; i++)
+    {
+        bool write = i % WRITE_EVERY == 0;
+        lock(write);
+        for (int j = 0; j < TABLE_SIZE; j++)
+        {
+            if (write)
+            {
+                table[j] = table[j] + 1;
+            }
+            else
+            {
+                sum += table[j];
+            }
+        }
+        unlock();
+    }
+    checksum = checksum + sum;
+    finished++;
+}
+
+void run(lock_kind which, const char *name)
+{
+    kind = which;
+    finished = 0;
+    double start = now_ms();
+    for (int i = 0; i < THREADS; i++)
+    {
+        uthread_spawn(worker);
+    }
+    while (finished < THREADS)
+    {
+        uthread_sleep_us(QUANTUM_USECS);
+    }
+    double elapsed = now_ms() - start;
+    printf("%-10s %12.2f %14.0f\n", name, elapsed, THREADS * OPERATIONS / elapsed);
+    fflush(stdout);
+}
+
+int main()
+{
+    uthread_init(QUANTUM_USECS);
+
+    printf("%-10s %12s %14s\n", "lock", "ms", "ops per ms");
+    run(MUTEX, "mutex");
+    run(RWLOCK, "rwlock");
+
+    long writes = 2L * THREADS * (OPERATIONS / WRITE_EVERY);
+    for (int j = 0; j < TABLE_SIZE; j++)
+    {
+        if (table[j] != writes)
+        {
+            error("a write was lost");
+        }
+    }
+    uthread_terminate(0);
+}
@@ -0,0 +1,166 @@
+/**********************************************
+ * Test 10: socket I/O parks only the calling thread
+ *
+ * a server thread waits in uthread_accept and uthread_read while
+ * a spinner thread and main keep running, then a client thread
+ * connects and exchanges a message with it over a UNIX socket.
+ * Finally main itself waits in uthread_read on a pipe that a
+ * writer thread fills a few quantums later, and both ends of the
+ * pipe are still blocking for everyone else afterwards.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define SOCKET_PATH "/tmp/uthreads_test10.sock"
+
+int listen_fd;
+int pipe_fds[2];
+volatile bool server_done = false;
+volatile bool client_done = false;
+volatile long spins = 0;
+char reply[16];
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void wait_next_quantum()
+{
+    int quantum = uthread_get_quantums(uthread_get_tid());
+    while (uthread_get_quantums(uthread_get_tid()) == quantum)
+    {}
+    return;
+}
+
+void spinner()
+{
+    while (true)
+    {
+        spins++;
+    }
+}
+
+void server()
+{
+    int fd = uthread_accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+    {
+        error("accept failed");
+    }
+    char buf[16] = {0};
+    if (uthread_read(fd, buf, sizeof(buf)) != 5 || strcmp(buf, "ping") != 0)
+    {
+        error("server read the wrong message");
+    }
+    if (uthread_write(fd, "pong", 5) != 5)
+    {
+        error("server write failed");
+    }
+    close(fd);
+    server_done = true;
+}
+
+void client()
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    if (uthread_connect(fd, (sockaddr *) &addr, sizeof(addr)) != 0)
+    {
+        error("connect failed");
+    }
+    if (uthread_write(fd, "ping", 5) != 5)
+    {
+        error("client write failed");
+    }
+    if (uthread_read(fd, reply, sizeof(reply)) != 5)
+    {
+        error("client read failed");
+    }
+    close(fd);
+    client_done = true;
+}
+
+void pipe_writer()
+{
+    wait_next_quantum();
+    wait_next_quantum();
+    uthread_write(pipe_fds[1], "done", 5);
+}
+
+int main()
+{
+    printf(GRN "Test 10:   " RESET);
+    fflush(stdout);
+    alarm(20); // a process blocked in a syscall never finishes
+
+    unlink(SOCKET_PATH);
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    if (bind(listen_fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(listen_fd, 4) != 0)
+    {
+        error("could not listen");
+    }
+
+    uthread_init(1000);
+    uthread_spawn(server);
+    uthread_spawn(spinner);
+
+    // the server is parked in accept, yet everybody else keeps running
+    for (int i = 0; i < 5; i++)
+    {
+        wait_next_quantum();
+    }
+    long spins_before = spins;
+    wait_next_quantum();
+    wait_next_quantum();
+    if (spins == spins_before || server_done)
+    {
+        error("threads stopped while the server waited");
+    }
+
+    uthread_spawn(client);
+    while (!server_done || !client_done)
+    {
+        wait_next_quantum();
+    }
+    if (strcmp(reply, "pong") != 0)
+    {
+        error("client got the wrong reply");
+    }
+
+    // main can wait too
+    pipe(pipe_fds);
+    uthread_spawn(pipe_writer);
+    char buf[8] = {0};
+    if (uthread_read(pipe_fds[0], buf, sizeof(buf)) != 5 || strcmp(buf, "done") != 0)
+    {
+        error("main read the wrong message");
+    }
+    if ((fcntl(pipe_fds[0], F_GETFL) & O_NONBLOCK) || (fcntl(pipe_fds[1], F_GETFL) & O_NONBLOCK))
+    {
+        error("the pipe was left non-blocking");
+    }
+
+    unlink(SOCKET_PATH);
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -0,0 +1,149 @@
+/**********************************************
+ * Test 11: file I/O through the scheduler's io_uring
+ *
+ * writer threads each own a block of a scratch file: they fill it
+ * with uthread_pwrite, flush it with uthread_fsync and read it back
+ * with uthread_pread, round after round, while a spinner keeps
+ * running. main terminates a reader while its request is in the ring
+ * and checks the buffer it was reading into is left alone afterwards.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define FILE_PATH "/tmp/uthreads_test11.dat"
+#define NUM_WRITERS 6
+#define BLOCK 512
+#define ROUNDS 20
+
+int file_fd;
+volatile int rounds_done[NUM_WRITERS + 2]; // by tid: the spinner is 1
+volatile long spins = 0;
+char victim_buf[BLOCK];
+volatile bool victim_reading = false;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void spinner()
+{
+    while (true)
+    {
+        spins++;
+    }
+}
+
+void writer()
+{
+    int tid = uthread_get_tid();
+    char out[BLOCK];
+    char in[BLOCK];
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        memset(out, 'a' + (tid + round) % 26, BLOCK);
+        if (uthread_pwrite(file_fd, out, BLOCK, (off_t) tid * BLOCK) != BLOCK)
+        {
+            error("pwrite failed");
+        }
+        if (uthread_fsync(file_fd) != 0)
+        {
+            error("fsync failed");
+        }
+        if (uthread_pread(file_fd, in, BLOCK, (off_t) tid * BLOCK) != BLOCK)
+        {
+            error("pread failed");
+        }
+        if (memcmp(in, out, BLOCK) != 0)
+        {
+            error("read back something else");
+        }
+        rounds_done[tid] = round + 1;
+    }
+}
+
+void victim()
+{
+    victim_reading = true;
+    uthread_pread(file_fd, victim_buf, BLOCK, 0);
+    error("the terminated reader came back");
+}
+
+int main()
+{
+    printf(GRN "Test 11:   " RESET);
+    fflush(stdout);
+
+    file_fd = open(FILE_PATH, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (file_fd < 0)
+    {
+        error("could not create the scratch file");
+    }
+
+    uthread_init(1000);
+    uthread_spawn(spinner);
+    for (int i = 0; i < NUM_WRITERS; i++)
+    {
+        uthread_spawn(writer);
+    }
+
+    bool done = false;
+    while (!done)
+    {
+        done = true;
+        for (int tid = 2; tid <= NUM_WRITERS + 1; tid++)
+        {
+            done = done && rounds_done[tid] == ROUNDS;
+        }
+    }
+    if (spins == 0)
+    {
+        error("the spinner never ran");
+    }
+
+    // main can read too, and the end of the file reads as 0
+    char buf[BLOCK];
+    if (uthread_pread(file_fd, buf, BLOCK, (off_t) (NUM_WRITERS + 2) * BLOCK) != 0)
+    {
+        error("read past the end of the file");
+    }
+
+    // terminate a reader whose request is in the ring; once terminate
+    // returns, the kernel must be done with its buffer
+    int victim_tid = uthread_spawn(victim);
+    while (!victim_reading)
+    {}
+    uthread_terminate(victim_tid);
+    memset(victim_buf, 'z', BLOCK);
+    int start = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < start + 3)
+    {}
+    for (int i = 0; i < BLOCK; i++)
+    {
+        if (victim_buf[i] != 'z')
+        {
+            error("a terminated thread's read landed afterwards");
+        }
+    }
+
+    if (uthread_pread(-1, buf, BLOCK, 0) != -1)
+    {
+        error("reading a bad fd did not fail");
+    }
+
+    close(file_fd);
+    unlink(FILE_PATH);
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
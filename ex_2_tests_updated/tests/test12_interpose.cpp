@@ -0,0 +1,117 @@
+/**********************************************
+ * Test 12: plain blocking calls park only their thread
+ *
+ * built with uthreads_wrap.cpp. A reader blocks in a plain read()
+ * on a pipe, a poller in poll() on another one, and a writer fills
+ * both after usleep() and nanosleep(). A spinner must keep running
+ * the whole time, and a poll() with nothing to wait for must time
+ * out. Before uthread_init the same calls simply go to libc.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <poll.h>
+#include <unistd.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+int read_pipe[2];
+int poll_pipe[2];
+volatile long spins = 0;
+volatile long spins_at_write = -1;
+volatile bool reader_done = false;
+volatile bool poller_done = false;
+volatile bool timed_out = false;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void spinner()
+{
+    while (true)
+    {
+        spins++;
+    }
+}
+
+void reader()
+{
+    char buf[8] = {0};
+    if (read(read_pipe[0], buf, sizeof(buf)) != 6 || strcmp(buf, "hello") != 0)
+    {
+        error("reader got the wrong message");
+    }
+    reader_done = true;
+}
+
+void poller()
+{
+    pollfd idle = {read_pipe[1], 0, 0}; // asks for nothing, never ready
+    if (poll(&idle, 1, 20) != 0)
+    {
+        error("poll without events did not time out");
+    }
+    timed_out = true;
+
+    pollfd fd = {poll_pipe[0], POLLIN, 0};
+    if (poll(&fd, 1, -1) != 1 || !(fd.revents & POLLIN))
+    {
+        error("poll returned without input");
+    }
+    poller_done = true;
+}
+
+void writer()
+{
+    usleep(5000);
+    spins_at_write = spins;
+    write(read_pipe[1], "hello", 6);
+    timespec nap = {0, 5000000};
+    nanosleep(&nap, nullptr);
+    write(poll_pipe[1], "x", 1);
+}
+
+int main()
+{
+    printf(GRN "Test 12:   " RESET);
+    fflush(stdout);
+    alarm(20); // a process blocked in a syscall never finishes
+
+    pipe(read_pipe);
+    pipe(poll_pipe);
+
+    // no library yet: straight to libc
+    write(poll_pipe[1], "y", 1);
+    char c;
+    pollfd fd = {poll_pipe[0], POLLIN, 0};
+    if (poll(&fd, 1, 0) != 1 || read(poll_pipe[0], &c, 1) != 1 || c != 'y')
+    {
+        error("calls before uthread_init failed");
+    }
+    usleep(1);
+
+    uthread_init(1000);
+    uthread_spawn(spinner);
+    uthread_spawn(reader);
+    uthread_spawn(poller);
+    uthread_spawn(writer);
+
+    while (!reader_done || !poller_done)
+    {}
+    if (!timed_out || spins_at_write <= 0 || spins == spins_at_write)
+    {
+        error("the spinner stopped while the others blocked");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
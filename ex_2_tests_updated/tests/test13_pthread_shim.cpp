@@ -0,0 +1,231 @@
+/**********************************************
+ * Test 13: pthreads code running on the shim
+ *
+ * written against plain pthreads only and built with
+ * uthreads_pthread.cpp: batches of threads are created and joined,
+ * workers share a counter under a mutex, a bounded buffer runs on
+ * condition variables, and pthread_once, keys and detached threads
+ * are checked. The create/join time is printed; run it again with
+ * UTHREADS_PTHREAD_SHIM=0 to compare with kernel threads.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define BATCH 50
+#define BATCHES 40
+#define WORKERS 8
+#define INCREMENTS 20000
+#define ITEMS 2000
+#define BUFFER 4
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void *twice(void *arg)
+{
+    return (void *) ((long) arg * 2);
+}
+
+pthread_mutex_t counter_lock = PTHREAD_MUTEX_INITIALIZER;
+long counter = 0;
+
+void *incrementer(void *)
+{
+    for (int i = 0; i < INCREMENTS; i++)
+    {
+        pthread_mutex_lock(&counter_lock);
+        long value = counter;
+        for (volatile int spin = 0; spin < 10; spin++)
+        {}
+        counter = value + 1;
+        pthread_mutex_unlock(&counter_lock);
+    }
+    return nullptr;
+}
+
+pthread_mutex_t buffer_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t not_full = PTHREAD_COND_INITIALIZER;
+pthread_cond_t not_empty = PTHREAD_COND_INITIALIZER;
+int buffer[BUFFER];
+int buffered = 0;
+long consumed_sum = 0;
+int consumed = 0;
+
+void *producer(void *)
+{
+    for (int item = 1; item <= ITEMS; item++)
+    {
+        pthread_mutex_lock(&buffer_lock);
+        while (buffered == BUFFER)
+        {
+            pthread_cond_wait(&not_full, &buffer_lock);
+        }
+        buffer[buffered++] = item;
+        pthread_cond_signal(&not_empty);
+        pthread_mutex_unlock(&buffer_lock);
+    }
+    return nullptr;
+}
+
+void *consumer(void *)
+{
+    while (true)
+    {
+        pthread_mutex_lock(&buffer_lock);
+        while (buffered == 0 && consumed < ITEMS)
+        {
+            pthread_cond_wait(&not_empty, &buffer_lock);
+        }
+        if (consumed == ITEMS)
+        {
+            pthread_cond_broadcast(&not_empty);
+            pthread_mutex_unlock(&buffer_lock);
+            return nullptr;
+        }
+        consumed_sum += buffer[--buffered];
+        consumed++;
+        pthread_cond_signal(&not_full);
+        pthread_mutex_unlock(&buffer_lock);
+    }
+}
+
+pthread_once_t once = PTHREAD_ONCE_INIT;
+volatile int once_calls = 0;
+pthread_key_t key;
+volatile int destructor_calls = 0;
+volatile int detached_runs = 0;
+
+void init_once()
+{
+    for (volatile int spin = 0; spin < 1000000; spin++)
+    {}
+    once_calls++;
+}
+
+void count_destructor(void *)
+{
+    destructor_calls++;
+}
+
+void *once_and_key(void *arg)
+{
+    pthread_once(&once, init_once);
+    if (once_calls != 1)
+    {
+        error("pthread_once returned before init finished");
+    }
+    pthread_setspecific(key, arg);
+    for (volatile int spin = 0; spin < 1000000; spin++)
+    {}
+    if (pthread_getspecific(key) != arg)
+    {
+        error("thread specific value was mixed up");
+    }
+    return nullptr;
+}
+
+void *detached(void *)
+{
+    detached_runs++;
+    return nullptr;
+}
+
+long elapsed_us(const timespec &start)
+{
+    timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_nsec - start.tv_nsec) / 1000;
+}
+
+int main()
+{
+    printf(GRN "Test 13:   " RESET);
+    fflush(stdout);
+
+    pthread_t threads[BATCH];
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int round = 0; round < BATCHES; round++)
+    {
+        for (long i = 0; i < BATCH; i++)
+        {
+            if (pthread_create(&threads[i], nullptr, twice, (void *) i) != 0)
+            {
+                error("pthread_create failed");
+            }
+        }
+        for (long i = 0; i < BATCH; i++)
+        {
+            void *result;
+            if (pthread_join(threads[i], &result) != 0 || (long) result != i * 2)
+            {
+                error("pthread_join returned the wrong value");
+            }
+        }
+    }
+    long create_join_us = elapsed_us(start);
+
+    for (int i = 0; i < WORKERS; i++)
+    {
+        pthread_create(&threads[i], nullptr, incrementer, nullptr);
+    }
+    for (int i = 0; i < WORKERS; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+    if (counter != (long) WORKERS * INCREMENTS)
+    {
+        error("the mutex let two threads in");
+    }
+
+    pthread_create(&threads[0], nullptr, producer, nullptr);
+    pthread_create(&threads[1], nullptr, consumer, nullptr);
+    pthread_create(&threads[2], nullptr, consumer, nullptr);
+    for (int i = 0; i < 3; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+    if (consumed_sum != (long) ITEMS * (ITEMS + 1) / 2)
+    {
+        error("the bounded buffer lost items");
+    }
+
+    pthread_key_create(&key, count_destructor);
+    for (long i = 0; i < WORKERS; i++)
+    {
+        pthread_create(&threads[i], nullptr, once_and_key, (void *) (i + 1));
+    }
+    for (int i = 0; i < WORKERS; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+    if (once_calls != 1 || destructor_calls != WORKERS)
+    {
+        error("pthread_once or the key destructors misbehaved");
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < WORKERS; i++)
+    {
+        pthread_create(&threads[i], &attr, detached, nullptr);
+    }
+    while (detached_runs != WORKERS)
+    {}
+
+    printf(GRN "SUCCESS" RESET " (%d threads created and joined in %ld us)\n",
+           BATCH * BATCHES, create_join_us);
+    pthread_exit(nullptr);
+}
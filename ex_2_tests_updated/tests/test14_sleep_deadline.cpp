@@ -0,0 +1,152 @@
+/**********************************************
+ * Test 14: microsecond sleeps on a long quantum
+ *
+ * with a 100ms quantum, short uthread_sleep_us calls must still
+ * take about as long as asked, never less: first with nobody else
+ * to run, then next to a spinner, where the early ticks for the
+ * deadlines must not count as quantums. Sleepers with different
+ * deadlines wake in deadline order, main may sleep too, and a
+ * terminated sleeper never wakes.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 100000
+#define NAP_USECS 500
+#define NAPS 20
+#define ORDERED 5
+
+volatile bool naps_done = false;
+volatile long longest_nap_ns = 0;
+volatile int woken[ORDERED];
+volatile int woken_amount = 0;
+volatile bool spinning = true;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void napper()
+{
+    for (int i = 0; i < NAPS; i++)
+    {
+        long long start = now_ns();
+        uthread_sleep_us(NAP_USECS);
+        long nap = (long) (now_ns() - start);
+        if (nap < NAP_USECS * 1000L)
+        {
+            error("woke up before the deadline");
+        }
+        if (nap > longest_nap_ns)
+        {
+            longest_nap_ns = nap;
+        }
+    }
+    naps_done = true;
+}
+
+void ordered_sleeper()
+{
+    int tid = uthread_get_tid();
+    // the last spawned has the earliest deadline
+    uthread_sleep_us((ORDERED + 1 - tid) * 2000);
+    woken[woken_amount++] = tid;
+}
+
+void spinner()
+{
+    while (spinning)
+    {}
+}
+
+void forgotten_sleeper()
+{
+    uthread_sleep_us(50000);
+    error("a terminated sleeper woke up");
+}
+
+int main()
+{
+    printf(GRN "Test 14:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+
+    // nobody else to run: the process idles exactly until each deadline
+    long long start = now_ns();
+    uthread_spawn(napper);
+    while (!naps_done)
+    {
+        uthread_sleep_us(200);
+    }
+    if (now_ns() - start > NAPS * 3000000LL)
+    {
+        error("idle sleeps overshot");
+    }
+
+    // deadline order, not spawn order
+    for (int i = 1; i <= ORDERED; i++)
+    {
+        uthread_spawn(ordered_sleeper);
+    }
+    while (woken_amount < ORDERED)
+    {
+        uthread_sleep_us(1000);
+    }
+    for (int i = 0; i < ORDERED; i++)
+    {
+        if (woken[i] != ORDERED - i)
+        {
+            error("sleepers woke out of deadline order");
+        }
+    }
+
+    // next to a spinner, a nap ends with the spinner's quantum at worst,
+    // and the deadline ticks do not start new quantums
+    naps_done = false;
+    longest_nap_ns = 0;
+    int spinner_tid = uthread_spawn(spinner);
+    int quantums_before = uthread_get_total_quantums();
+    uthread_spawn(napper);
+    while (!naps_done)
+    {
+        uthread_sleep_us(1000);
+    }
+    int quantums = uthread_get_total_quantums() - quantums_before;
+    if (longest_nap_ns > 3LL * QUANTUM_USECS * 1000)
+    {
+        error("a nap next to the spinner took several quantums");
+    }
+    if (quantums > 3 * NAPS)
+    {
+        error("deadline ticks were counted as quantums");
+    }
+    spinning = false;
+    uthread_terminate(spinner_tid);
+
+    // a terminated sleeper's deadline goes away with it
+    int forgotten = uthread_spawn(forgotten_sleeper);
+    uthread_sleep_us(1000);
+    uthread_terminate(forgotten);
+    uthread_sleep_us(100000);
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
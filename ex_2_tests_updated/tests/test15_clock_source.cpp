@@ -0,0 +1,143 @@
+/**********************************************
+ * Test 15: clock sources
+ *
+ * runs the same checks under every clock source, each in a child
+ * process of its own: quantums are counted while the threads run,
+ * a thread sleeping for quantums wakes while main waits on a pipe,
+ * and the ticks merged while a thread kept the signal blocked are
+ * counted as the quantums they stand for (by every source but the
+ * virtual one, which cannot tell).
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <csignal>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 10000
+#define SLEEP_QUANTUMS 5
+#define BLOCKED_QUANTUMS 10
+
+const char *source_names[] = {"virtual", "prof", "real", "posix"};
+int source;
+int wake_pipe[2];
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s clock: %s\n" RESET, source_names[source], what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void spin_for(long long ns)
+{
+    long long end = now_ns() + ns;
+    while (now_ns() < end)
+    {}
+}
+
+void spinner()
+{
+    while (true)
+    {}
+}
+
+void waker()
+{
+    uthread_sleep(SLEEP_QUANTUMS);
+    uthread_write(wake_pipe[1], "x", 1);
+}
+
+void run_checks()
+{
+    if (uthread_init_clock(QUANTUM_USECS, source) != 0)
+    {
+        error("uthread_init_clock failed");
+    }
+
+    // running: about one quantum per quantum of time
+    int spinner_tid = uthread_spawn(spinner);
+    int before = uthread_get_total_quantums();
+    spin_for(20LL * QUANTUM_USECS * 1000);
+    int ran = uthread_get_total_quantums() - before;
+    if (ran < 10 || ran > 30)
+    {
+        error("quantums did not follow the time spent running");
+    }
+    uthread_terminate(spinner_tid);
+
+    // nothing to run: the sleeper still wakes and lets main go
+    pipe(wake_pipe);
+    uthread_spawn(waker);
+    long long start = now_ns();
+    char c;
+    if (uthread_read(wake_pipe[0], &c, 1) != 1)
+    {
+        error("main did not get the wake up");
+    }
+    long long waited_ns = now_ns() - start;
+    if (waited_ns < (SLEEP_QUANTUMS - 1) * QUANTUM_USECS * 1000LL
+        || waited_ns > 4LL * SLEEP_QUANTUMS * QUANTUM_USECS * 1000)
+    {
+        error("the sleeper did not wake on time while main waited");
+    }
+
+    // ticks merged while the signal was blocked still count
+    sigset_t all, old;
+    sigfillset(&all);
+    before = uthread_get_total_quantums();
+    sigprocmask(SIG_BLOCK, &all, &old);
+    spin_for(BLOCKED_QUANTUMS * QUANTUM_USECS * 1000LL);
+    sigprocmask(SIG_SETMASK, &old, nullptr);
+    int counted = uthread_get_total_quantums() - before;
+    int expected = source == UTHREAD_CLOCK_VIRTUAL ? 1 : BLOCKED_QUANTUMS - 1;
+    if (counted < expected || counted > BLOCKED_QUANTUMS + 3)
+    {
+        error("merged ticks were not compensated");
+    }
+
+    uthread_terminate(0);
+}
+
+int main()
+{
+    printf(GRN "Test 15:   " RESET);
+    fflush(stdout);
+
+    if (uthread_init_clock(QUANTUM_USECS, 42) != -1)
+    {
+        error("an unknown clock source was accepted");
+    }
+
+    for (source = UTHREAD_CLOCK_VIRTUAL; source <= UTHREAD_CLOCK_POSIX; source++)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            run_checks();
+        }
+        int status;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            exit(1); // the child printed what went wrong
+        }
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    return 0;
+}
@@ -0,0 +1,164 @@
+/**********************************************
+ * Test 16: timer slack
+ *
+ * with a global slack, sleepers whose deadlines are spread inside
+ * one slack window all wake in the same pass, after the last of
+ * the deadlines and never before their own. A thread with a slack
+ * of its own (0) keeps waking on time, and quantum sleeps of 1 to
+ * 6 quantums started together wake on at most 3 different ticks.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 5000
+#define SLACK_USECS 20000
+#define SLACK_NS (SLACK_USECS * 1000LL)
+#define SPREAD_SLEEPERS 40
+#define QUANTUM_SLEEPERS 6
+
+long long window_start;
+long long deadline_of[MAX_THREAD_NUM];
+long long latest_deadline;
+volatile int woken = 0;
+volatile long long worst_lateness_ns = 0;
+int wake_ticks[QUANTUM_SLEEPERS];
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+long long next_grid_point(long long after)
+{
+    return (after / SLACK_NS + 1) * SLACK_NS;
+}
+
+void spread_sleeper()
+{
+    long long deadline = deadline_of[uthread_get_tid()];
+    uthread_sleep_until(deadline);
+    long long now = now_ns();
+    if (now < latest_deadline)
+    {
+        error("a sleeper woke before the others of its slack window");
+    }
+    if (now > window_start + 2 * SLACK_NS)
+    {
+        error("a sleeper woke later than its slack allows");
+    }
+    woken++;
+}
+
+void exact_sleeper()
+{
+    uthread_set_thread_slack(uthread_get_tid(), 0);
+    for (int i = 0; i < 5; i++)
+    {
+        // just past a grid point: the global slack would add almost all of it
+        long long deadline = next_grid_point(now_ns() + 2000000) + 1000000;
+        uthread_sleep_until(deadline);
+        long long lateness = now_ns() - deadline;
+        if (lateness < 0)
+        {
+            error("the exact sleeper woke early");
+        }
+        if (lateness > worst_lateness_ns)
+        {
+            worst_lateness_ns = lateness;
+        }
+    }
+    woken++;
+}
+
+void quantum_sleeper()
+{
+    int tid = uthread_get_tid();
+    int start = uthread_get_total_quantums();
+    int quantums = tid % QUANTUM_SLEEPERS + 1;
+    uthread_sleep(quantums);
+    int wake = uthread_get_total_quantums();
+    if (wake < start + quantums + 1)
+    {
+        error("a quantum sleep ended early");
+    }
+    wake_ticks[woken++] = wake;
+}
+
+void wait_for(int amount)
+{
+    while (woken < amount)
+    {
+        uthread_sleep_us(1000);
+    }
+}
+
+int main()
+{
+    printf(GRN "Test 16:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_set_timer_slack(-1) != -1)
+    {
+        error("a negative slack was accepted");
+    }
+    uthread_set_timer_slack(SLACK_USECS);
+
+    // deadlines 100us apart, all inside one slack window
+    window_start = next_grid_point(now_ns() + SLACK_NS);
+    for (int i = 0; i < SPREAD_SLEEPERS; i++)
+    {
+        int tid = uthread_spawn(spread_sleeper);
+        deadline_of[tid] = window_start + 1000000 + i * 100000LL;
+        latest_deadline = deadline_of[tid];
+    }
+    wait_for(SPREAD_SLEEPERS);
+
+    woken = 0;
+    uthread_spawn(exact_sleeper);
+    wait_for(1);
+    if (worst_lateness_ns > 5000000)
+    {
+        error("a thread without slack woke late");
+    }
+
+    woken = 0;
+    for (int i = 0; i < QUANTUM_SLEEPERS; i++)
+    {
+        uthread_spawn(quantum_sleeper);
+    }
+    wait_for(QUANTUM_SLEEPERS);
+    int distinct = 0;
+    for (int i = 0; i < QUANTUM_SLEEPERS; i++)
+    {
+        bool seen = false;
+        for (int j = 0; j < i; j++)
+        {
+            seen = seen || wake_ticks[j] == wake_ticks[i];
+        }
+        distinct += !seen;
+    }
+    if (distinct > 3)
+    {
+        error("quantum sleeps were not rounded to the slack");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -0,0 +1,143 @@
+/**********************************************
+ * Test 17: callback timers
+ *
+ * a one-shot timer fires once and not early, a periodic one keeps
+ * its rate, a cancelled one never fires and a rescheduled one fires
+ * at its new time. Timers due together run in one batch on the same
+ * library thread, and a periodic callback may cancel its own timer.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 10000
+#define PERIOD_USECS 2000
+#define RUN_USECS 50000
+#define BATCH 20
+#define SELF_CANCEL_AFTER 5
+
+volatile int one_shot_calls = 0;
+volatile long long one_shot_at = 0;
+volatile int periodic_calls = 0;
+volatile int cancelled_calls = 0;
+volatile int rescheduled_calls = 0;
+volatile int batch_calls = 0;
+volatile int batch_tid = -1;
+volatile bool batch_split = false;
+volatile int self_cancel_calls = 0;
+int self_cancel_timer;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void count(void *calls)
+{
+    (*(volatile int *) calls)++;
+}
+
+void one_shot(void *)
+{
+    one_shot_at = now_ns();
+    one_shot_calls++;
+}
+
+void batched(void *)
+{
+    if (batch_tid == -1)
+    {
+        batch_tid = uthread_get_tid();
+    }
+    batch_split = batch_split || uthread_get_tid() != batch_tid;
+    batch_calls++;
+}
+
+void self_cancel(void *)
+{
+    if (++self_cancel_calls == SELF_CANCEL_AFTER)
+    {
+        uthread_timer_cancel(self_cancel_timer);
+    }
+}
+
+void wait_us(long usecs)
+{
+    long long end = now_ns() + usecs * 1000LL;
+    while (now_ns() < end)
+    {
+        uthread_sleep_us(500);
+    }
+}
+
+int main()
+{
+    printf(GRN "Test 17:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_timer_create(nullptr, nullptr, 1000, 0) != -1 || uthread_timer_cancel(3) != -1)
+    {
+        error("a bad timer call succeeded");
+    }
+
+    long long start = now_ns();
+    uthread_timer_create(one_shot, nullptr, 5000, 0);
+    uthread_timer_create(count, (void *) &periodic_calls, PERIOD_USECS, PERIOD_USECS);
+    int cancelled = uthread_timer_create(count, (void *) &cancelled_calls, 10000, 0);
+    int rescheduled = uthread_timer_create(count, (void *) &rescheduled_calls, 10000000, 0);
+    self_cancel_timer = uthread_timer_create(self_cancel, nullptr, 1000, 1000);
+    uthread_timer_cancel(cancelled);
+    uthread_timer_reschedule(rescheduled, 3000, 0);
+    wait_us(RUN_USECS);
+
+    if (one_shot_calls != 1 || one_shot_at - start < 5000000)
+    {
+        error("the one-shot timer misfired");
+    }
+    if (periodic_calls < RUN_USECS / PERIOD_USECS / 2 || periodic_calls > RUN_USECS / PERIOD_USECS + 1)
+    {
+        error("the periodic timer did not keep its rate");
+    }
+    if (cancelled_calls != 0)
+    {
+        error("a cancelled timer fired");
+    }
+    if (rescheduled_calls != 1)
+    {
+        error("the rescheduled timer did not fire at its new time");
+    }
+    if (self_cancel_calls != SELF_CANCEL_AFTER)
+    {
+        error("a timer cancelled from its own callback kept firing");
+    }
+
+    // due together: one batch on the timer thread
+    for (int i = 0; i < BATCH; i++)
+    {
+        uthread_timer_create(batched, nullptr, 2000, 0);
+    }
+    wait_us(20000);
+    if (batch_calls != BATCH || batch_split || batch_tid == 0)
+    {
+        error("the batch did not run on the timer thread");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -0,0 +1,186 @@
+/**********************************************
+ * Test 18: task groups and parallel for
+ *
+ * the merge sort of jona5 without fixed tids or status flags: each
+ * level spawns the left half into a task group, sorts the right
+ * half itself and waits. uthread_parallel_for then covers a range
+ * far larger than the thread limit exactly once, and a thread
+ * waiting on a group parks instead of spinning through quantums.
+ * With every thread id taken, a task runs in its spawner, which is
+ * told so by UTHREAD_RAN_INLINE rather than a thread id.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define ARRAY_SIZE 8192
+#define SMALL 256
+#define RANGE 200000
+#define GRAIN 100
+#define SPIN_QUANTUMS 20
+
+int array[ARRAY_SIZE];
+int scratch[ARRAY_SIZE];
+char visits[RANGE];
+
+struct sort_job
+{
+    int begin;
+    int end;
+};
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void merge(int begin, int middle, int end)
+{
+    int left = begin, right = middle, out = begin;
+    while (left < middle || right < end)
+    {
+        if (right == end || (left < middle && array[left] <= array[right]))
+        {
+            scratch[out++] = array[left++];
+        }
+        else
+        {
+            scratch[out++] = array[right++];
+        }
+    }
+    for (int i = begin; i < end; i++)
+    {
+        array[i] = scratch[i];
+    }
+}
+
+void merge_sort(void *arg)
+{
+    sort_job *job = (sort_job *) arg;
+    if (job->end - job->begin <= SMALL)
+    {
+        for (int i = job->begin + 1; i < job->end; i++)
+        {
+            for (int j = i; j > job->begin && array[j - 1] > array[j]; j--)
+            {
+                int temp = array[j];
+                array[j] = array[j - 1];
+                array[j - 1] = temp;
+            }
+        }
+        return;
+    }
+    int middle = job->begin + (job->end - job->begin) / 2;
+    sort_job left = {job->begin, middle};
+    sort_job right = {middle, job->end};
+    uthread_task_group_t group = UTHREAD_TASK_GROUP_INITIALIZER;
+    uthread_task_group_spawn(&group, merge_sort, &left);
+    merge_sort(&right);
+    uthread_task_group_wait(&group);
+    merge(job->begin, middle, job->end);
+}
+
+void visit(long begin, long end, void *arg)
+{
+    if (end - begin > GRAIN || arg != visits)
+    {
+        error("parallel for passed a wrong piece");
+    }
+    for (long i = begin; i < end; i++)
+    {
+        visits[i]++;
+    }
+}
+
+void spin_quantums(void *)
+{
+    int tid = uthread_get_tid();
+    int start = uthread_get_quantums(tid);
+    while (uthread_get_quantums(tid) < start + SPIN_QUANTUMS)
+    {}
+}
+
+void mark(void *ran)
+{
+    *(bool *) ran = true;
+}
+
+void parked()
+{
+    uthread_block(uthread_get_tid());
+}
+
+int main()
+{
+    printf(GRN "Test 18:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+
+    srand(1430);
+    for (int i = 0; i < ARRAY_SIZE; i++)
+    {
+        array[i] = rand() % 100000;
+    }
+    sort_job whole = {0, ARRAY_SIZE};
+    merge_sort(&whole);
+    for (int i = 1; i < ARRAY_SIZE; i++)
+    {
+        if (array[i - 1] > array[i])
+        {
+            error("the array is not sorted");
+        }
+    }
+
+    if (uthread_parallel_for(0, RANGE, 0, visit, visits) != -1)
+    {
+        error("a grain of 0 was accepted");
+    }
+    uthread_parallel_for(0, RANGE, GRAIN, visit, visits);
+    for (int i = 0; i < RANGE; i++)
+    {
+        if (visits[i] != 1)
+        {
+            error("parallel for did not visit every index exactly once");
+        }
+    }
+
+    // main waits parked: the two spinners get its quantums
+    uthread_task_group_t group = UTHREAD_TASK_GROUP_INITIALIZER;
+    uthread_task_group_spawn(&group, spin_quantums, nullptr);
+    uthread_task_group_spawn(&group, spin_quantums, nullptr);
+    int main_quantums = uthread_get_quantums(0);
+    uthread_task_group_wait(&group);
+    if (uthread_get_quantums(0) - main_quantums > 2)
+    {
+        error("main spun while it waited for the group");
+    }
+
+    int fillers[MAX_THREAD_NUM];
+    int filled = 0;
+    while ((fillers[filled] = uthread_spawn(parked)) != -1)
+    {
+        filled++;
+    }
+    bool ran = false;
+    if (uthread_task_group_spawn(&group, mark, &ran) != UTHREAD_RAN_INLINE || !ran)
+    {
+        error("a task without a free thread id did not run inline");
+    }
+    uthread_task_group_wait(&group);
+    for (int i = 0; i < filled; i++)
+    {
+        uthread_terminate(fillers[i]);
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
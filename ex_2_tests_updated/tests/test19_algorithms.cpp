@@ -0,0 +1,118 @@
+/**********************************************
+ * Test 19: parallel algorithms
+ *
+ * uthread::sort, reduce, inclusive_scan and transform from
+ * uthreads_algorithms.h against their serial std counterparts, on
+ * sizes around the chunk and merge boundaries, with the default
+ * grain and with one small enough to run out of thread ids, a
+ * custom comparator, an operator that is not commutative and a
+ * scan in place.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "../uthreads_algorithms.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+
+void error(const char *what, long n)
+{
+    printf(RED "ERROR - %s (n = %ld)\n" RESET, what, n);
+    exit(1);
+}
+
+// keeps the left one: associative, not commutative
+int left_of(int a, int b)
+{
+    (void) b;
+    return a;
+}
+
+void check_size(long n, long grain)
+{
+    std::vector<int> data(n), expected;
+    for (long i = 0; i < n; i++)
+    {
+        data[i] = rand() % 1000 - 500;
+    }
+
+    expected = data;
+    std::vector<int> sorted = data;
+    std::sort(expected.begin(), expected.end());
+    uthread::sort(sorted.data(), sorted.data() + n, std::less<int>(), grain);
+    if (sorted != expected)
+    {
+        error("sort", n);
+    }
+    sorted = data;
+    std::sort(expected.begin(), expected.end(), std::greater<int>());
+    uthread::sort(sorted.data(), sorted.data() + n, std::greater<int>(), grain);
+    if (sorted != expected)
+    {
+        error("sort by a comparator", n);
+    }
+
+    long long sum = std::accumulate(data.begin(), data.end(), 7LL);
+    std::vector<long long> wide(data.begin(), data.end());
+    if (uthread::reduce(wide.data(), wide.data() + n, 7LL, std::plus<long long>(), grain) != sum)
+    {
+        error("reduce", n);
+    }
+    if (n > 0 && uthread::reduce(data.data(), data.data() + n, 42, left_of, grain) != 42)
+    {
+        error("reduce kept the order", n);
+    }
+
+    std::vector<long long> scanned(n), expected_scan(n);
+    std::partial_sum(wide.begin(), wide.end(), expected_scan.begin());
+    uthread::inclusive_scan(wide.data(), wide.data() + n, scanned.data(), std::plus<long long>(), grain);
+    if (scanned != expected_scan)
+    {
+        error("inclusive_scan", n);
+    }
+    uthread::inclusive_scan(wide.data(), wide.data() + n, wide.data(), std::plus<long long>(), grain);
+    if (wide != expected_scan)
+    {
+        error("inclusive_scan in place", n);
+    }
+
+    std::vector<double> halves(n);
+    uthread::transform(data.data(), data.data() + n, halves.data(), [](int x) { return x / 2.0; }, grain);
+    for (long i = 0; i < n; i++)
+    {
+        if (halves[i] != data[i] / 2.0)
+        {
+            error("transform", n);
+        }
+    }
+}
+
+int main()
+{
+    printf(GRN "Test 19:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    srand(19);
+
+    long sizes[] = {0, 1, 2, 7, 100, 4095, 4096, 4097, 3 * 4096 + 5, 250000, 1000003};
+    for (long n : sizes)
+    {
+        check_size(n, 0);
+    }
+    // 64-element chunks: many more than there are thread ids
+    check_size(20000, 64);
+    check_size(1001, 3);
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -0,0 +1,150 @@
+/**********************************************
+ * Test 20: barriers and latches
+ *
+ * every thread id in use: the main thread and 99 workers go through
+ * a barrier round after round. No one may leave a round before all
+ * arrived, exactly one thread a round is told it was the last, and
+ * since the waiters park instead of spinning through quantums, the
+ * rounds take a small fraction of a quantum per thread. A latch
+ * then releases several waiters at once after its count downs.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define PARTIES MAX_THREAD_NUM
+#define ROUNDS 20
+#define LATCH_COUNT 10
+#define LATCH_WAITERS 5
+
+uthread_barrier_t barrier;
+volatile int phase[MAX_THREAD_NUM];
+volatile int serials[ROUNDS];
+uthread_latch_t latch = UTHREAD_LATCH_INITIALIZER(LATCH_COUNT);
+volatile int counted_down = 0;
+volatile int latch_passed = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void rounds()
+{
+    int tid = uthread_get_tid();
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        phase[tid] = round;
+        int result = uthread_barrier_wait(&barrier);
+        if (result == UTHREAD_BARRIER_SERIAL_THREAD)
+        {
+            serials[round]++;
+        }
+        else if (result != 0)
+        {
+            error("uthread_barrier_wait failed");
+        }
+        for (int other = 0; other < PARTIES; other++)
+        {
+            if (phase[other] < round)
+            {
+                error("a thread left the barrier before all arrived");
+            }
+        }
+    }
+}
+
+void latch_waiter()
+{
+    uthread_latch_wait(&latch);
+    if (counted_down != LATCH_COUNT)
+    {
+        error("the latch opened early");
+    }
+    latch_passed++;
+}
+
+void counter()
+{
+    counted_down++;
+    uthread_latch_count_down(&latch, 1);
+}
+
+int main()
+{
+    printf(GRN "Test 20:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_barrier_init(&barrier, 0) != -1)
+    {
+        error("a barrier for no one was accepted");
+    }
+    uthread_barrier_init(&barrier, PARTIES);
+
+    long long start = now_ns();
+    for (int i = 1; i < PARTIES; i++)
+    {
+        if (uthread_spawn(rounds) == -1)
+        {
+            error("could not spawn all the parties");
+        }
+    }
+    rounds();
+    long long elapsed = now_ns() - start;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        if (serials[round] != 1)
+        {
+            error("not exactly one serial thread a round");
+        }
+    }
+    // spinning waiters would take about a quantum each, every round
+    if (elapsed > (long long) ROUNDS * PARTIES * QUANTUM_USECS * 1000 / 10)
+    {
+        error("the barrier rounds took as long as spinning");
+    }
+
+    // let the workers end, then reuse their ids
+    uthread_sleep_us(10000);
+    for (int i = 0; i < LATCH_WAITERS; i++)
+    {
+        uthread_spawn(latch_waiter);
+    }
+    for (int i = 0; i < LATCH_COUNT; i++)
+    {
+        uthread_spawn(counter);
+    }
+    uthread_latch_wait(&latch);
+    if (uthread_latch_count_down(&latch, 1) != -1)
+    {
+        error("the latch was counted below zero");
+    }
+    while (latch_passed < LATCH_WAITERS)
+    {
+        uthread_sleep_us(1000);
+    }
+
+    uthread_latch_t open;
+    uthread_latch_init(&open, 0);
+    uthread_latch_wait(&open);
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
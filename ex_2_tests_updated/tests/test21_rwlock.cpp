@@ -0,0 +1,219 @@
+/**********************************************
+ * Test 21: reader-writer lock and mutex
+ *
+ * readers hold the lock together (all of them inside at once),
+ * writers alone (a pair written in two steps is never seen torn),
+ * and a waiting writer goes before readers that come after it.
+ * A writer handed the lock but terminated before it runs passes it
+ * on. A mutex keeps a shared counter exact under preemption.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define READERS 5
+#define MIXED_READERS 6
+#define MIXED_WRITERS 3
+#define ITERATIONS 300
+#define INCREMENTERS 5
+#define INCREMENTS 20000
+
+uthread_rwlock_t rwlock = UTHREAD_RWLOCK_INITIALIZER;
+volatile int inside = 0;
+volatile int most_inside = 0;
+volatile int finished = 0;
+volatile long first_half = 0, second_half = 0;
+volatile bool writer_queued = false;
+char order[4];
+volatile int order_length = 0;
+volatile bool after_handed = false;
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+volatile long counter = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void spin(int amount)
+{
+    for (volatile int i = 0; i < amount; i++)
+    {}
+}
+
+void together()
+{
+    uthread_rwlock_rdlock(&rwlock);
+    inside++;
+    while (inside < READERS)
+    {} // only gets out if the others come in meanwhile
+    most_inside = inside;
+    uthread_rwlock_unlock(&rwlock);
+    finished++;
+}
+
+void mixed_reader()
+{
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        uthread_rwlock_rdlock(&rwlock);
+        long first = first_half;
+        spin(2000);
+        if (first != second_half)
+        {
+            error("a reader saw a write half done");
+        }
+        uthread_rwlock_unlock(&rwlock);
+    }
+    finished++;
+}
+
+void mixed_writer()
+{
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        uthread_rwlock_wrlock(&rwlock);
+        first_half = first_half + 1;
+        spin(2000);
+        second_half = first_half;
+        uthread_rwlock_unlock(&rwlock);
+    }
+    finished++;
+}
+
+void queued_writer()
+{
+    writer_queued = true;
+    uthread_rwlock_wrlock(&rwlock);
+    order[order_length++] = 'W';
+    uthread_rwlock_unlock(&rwlock);
+}
+
+void late_reader()
+{
+    uthread_rwlock_rdlock(&rwlock);
+    order[order_length++] = 'R';
+    uthread_rwlock_unlock(&rwlock);
+}
+
+// gets the lock that a terminated writer was handed
+void after_writer()
+{
+    uthread_rwlock_wrlock(&rwlock);
+    after_handed = true;
+    uthread_rwlock_unlock(&rwlock);
+}
+
+void incrementer()
+{
+    for (int i = 0; i < INCREMENTS; i++)
+    {
+        uthread_mutex_lock(&mutex);
+        long value = counter;
+        spin(10);
+        counter = value + 1;
+        uthread_mutex_unlock(&mutex);
+    }
+    finished++;
+}
+
+void wait_finished(int amount)
+{
+    while (finished < amount)
+    {}
+    finished = 0;
+}
+
+int main()
+{
+    printf(GRN "Test 21:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_rwlock_unlock(&rwlock) != -1)
+    {
+        error("an unlocked rwlock was unlocked");
+    }
+
+    for (int i = 0; i < READERS; i++)
+    {
+        uthread_spawn(together);
+    }
+    wait_finished(READERS);
+    if (most_inside != READERS)
+    {
+        error("the readers did not hold the lock together");
+    }
+
+    for (int i = 0; i < MIXED_READERS; i++)
+    {
+        uthread_spawn(mixed_reader);
+    }
+    for (int i = 0; i < MIXED_WRITERS; i++)
+    {
+        uthread_spawn(mixed_writer);
+    }
+    wait_finished(MIXED_READERS + MIXED_WRITERS);
+    if (first_half != MIXED_WRITERS * ITERATIONS)
+    {
+        error("two writers were inside together");
+    }
+
+    // main reads; a writer queues up; a reader coming after it must wait for it
+    uthread_rwlock_rdlock(&rwlock);
+    uthread_spawn(queued_writer);
+    while (!writer_queued)
+    {}
+    uthread_spawn(late_reader);
+    uthread_sleep_us(20000);
+    if (order_length != 0)
+    {
+        error("someone got in next to a reader and a waiting writer");
+    }
+    uthread_rwlock_unlock(&rwlock);
+    while (order_length < 2)
+    {
+        uthread_sleep_us(1000);
+    }
+    if (order[0] != 'W' || order[1] != 'R')
+    {
+        error("a reader went before the writer waiting ahead of it");
+    }
+
+    // the writer is handed the lock on unlock, and terminated before it runs
+    uthread_rwlock_rdlock(&rwlock);
+    writer_queued = false;
+    int handed = uthread_spawn(queued_writer);
+    while (!writer_queued)
+    {}
+    uthread_spawn(after_writer);
+    uthread_sleep_us(2000);
+    uthread_rwlock_unlock(&rwlock);
+    uthread_terminate(handed);
+    uthread_sleep_us(5000);
+    if (!after_handed || order_length != 2)
+    {
+        error("a writer terminated before it ran kept the lock");
+    }
+
+    for (int i = 0; i < INCREMENTERS; i++)
+    {
+        uthread_spawn(incrementer);
+    }
+    wait_finished(INCREMENTERS);
+    if (counter != (long) INCREMENTERS * INCREMENTS)
+    {
+        error("the mutex let two threads in");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
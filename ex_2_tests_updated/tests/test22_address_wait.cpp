@@ -0,0 +1,194 @@
+/**********************************************
+ * Test 22: waiting on an address
+ *
+ * uthread_wait_on returns at once when the value changed already,
+ * uthread_wake wakes as many waiters as asked, oldest first, and
+ * only those of its own address even when more addresses than
+ * there are buckets have waiters. A mutex built on one int with
+ * atomic builtins and these two calls (no thread ids anywhere)
+ * then keeps a shared counter exact under preemption.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define WAITERS 5
+#define ADDRESSES 90
+#define LOCKERS 6
+#define INCREMENTS 20000
+
+volatile int flag = 0;
+volatile int woke[MAX_THREAD_NUM];
+int order[WAITERS];
+volatile int order_length = 0;
+volatile int words[ADDRESSES];
+volatile int word_woken[ADDRESSES];
+volatile int lock_word = 0; // 0 free, 1 held, 2 held with waiters
+volatile long counter = 0;
+volatile int finished = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void flag_waiter()
+{
+    int tid = uthread_get_tid();
+    while (flag == 0)
+    {
+        uthread_wait_on(&flag, 0);
+    }
+    order[order_length++] = tid;
+}
+
+void word_waiter(void *arg)
+{
+    long i = (long) arg;
+    while (words[i] == 0)
+    {
+        uthread_wait_on(&words[i], 0);
+    }
+    word_woken[i]++;
+}
+
+void lock()
+{
+    int seen = __sync_val_compare_and_swap(&lock_word, 0, 1);
+    if (seen == 0)
+    {
+        return;
+    }
+    if (seen != 2)
+    {
+        seen = __sync_lock_test_and_set(&lock_word, 2);
+    }
+    while (seen != 0)
+    {
+        uthread_wait_on(&lock_word, 2);
+        seen = __sync_lock_test_and_set(&lock_word, 2);
+    }
+}
+
+void unlock()
+{
+    if (__sync_fetch_and_sub(&lock_word, 1) != 1)
+    {
+        lock_word = 0;
+        uthread_wake(&lock_word, 1);
+    }
+}
+
+void locker()
+{
+    for (int i = 0; i < INCREMENTS; i++)
+    {
+        lock();
+        long value = counter;
+        for (volatile int j = 0; j < 10; j++)
+        {}
+        counter = value + 1;
+        unlock();
+    }
+    finished++;
+}
+
+int main()
+{
+    printf(GRN "Test 22:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_wait_on(&flag, 1) != -1 || errno != EAGAIN)
+    {
+        error("waited although the value had changed");
+    }
+    if (uthread_wake(&flag, 1) != 0)
+    {
+        error("woke someone while nobody waited");
+    }
+    if (uthread_wake(&flag, 0) != -1 || uthread_wait_on(nullptr, 0) != -1)
+    {
+        error("bad arguments were accepted");
+    }
+
+    int tids[WAITERS];
+    for (int i = 0; i < WAITERS; i++)
+    {
+        tids[i] = uthread_spawn(flag_waiter);
+        uthread_sleep_us(2000); // parks before the next one comes
+    }
+    flag = 1;
+    if (uthread_wake(&flag, 2) != 2)
+    {
+        error("did not wake the two asked for");
+    }
+    uthread_sleep_us(5000);
+    if (order_length != 2)
+    {
+        error("more than two waiters went on");
+    }
+    if (uthread_wake(&flag, MAX_THREAD_NUM) != WAITERS - 2)
+    {
+        error("did not wake the rest");
+    }
+    while (order_length < WAITERS)
+    {
+        uthread_sleep_us(1000);
+    }
+    for (int i = 0; i < WAITERS; i++)
+    {
+        if (order[i] != tids[i])
+        {
+            error("the waiters were not woken oldest first");
+        }
+    }
+
+    // more addresses than buckets: some share one, and must not be woken for another
+    for (long i = 0; i < ADDRESSES; i++)
+    {
+        uthread_spawn_arg(word_waiter, (void *) i);
+    }
+    uthread_sleep_us(10000);
+    for (int i = 0; i < ADDRESSES; i++)
+    {
+        words[i] = 1;
+        if (uthread_wake(&words[i], MAX_THREAD_NUM) != 1)
+        {
+            error("a wake did not find its one waiter");
+        }
+    }
+    uthread_sleep_us(10000);
+    for (int i = 0; i < ADDRESSES; i++)
+    {
+        if (word_woken[i] != 1)
+        {
+            error("a waiter went on without its wake");
+        }
+    }
+
+    for (int i = 0; i < LOCKERS; i++)
+    {
+        uthread_spawn(locker);
+    }
+    while (finished < LOCKERS)
+    {
+        uthread_sleep_us(1000);
+    }
+    if (counter != (long) LOCKERS * INCREMENTS)
+    {
+        error("the lock built on an address let two threads in");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
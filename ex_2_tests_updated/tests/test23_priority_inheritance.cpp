@@ -0,0 +1,240 @@
+/**********************************************
+ * Test 23: priorities and priority inheritance
+ *
+ * a READY thread of a higher priority runs first, and a mutex wakes
+ * its most urgent waiter first. Then the classic inversion: a low
+ * thread holds a mutex a high one waits for while medium threads
+ * spin for as long as the high one has not got through. Only if
+ * the low holder inherits the high priority does it get to unlock,
+ * so the high thread gets through within the time limit, the low
+ * one runs with its priority meanwhile, and drops it on unlock.
+ * Terminating a holder unlocks its mutex for the waiters and for
+ * the next thread of its id, terminating a waiter takes back what
+ * it lent the holder, and one woken but ended before it ran
+ * passes the mutex on.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define LOW 0
+#define MEDIUM 3
+#define HIGH 6
+#define TOP (UTHREAD_PRIORITY_LEVELS - 1)
+#define MEDIUMS 3
+#define HOLD_QUANTUMS 5
+#define LIMIT_MS 2000
+
+char order[8];
+volatile int order_length = 0;
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+volatile bool holding = false;
+volatile bool high_done = false;
+volatile int low_highest = -1;
+volatile int low_after = -1;
+volatile int stranger_unlocked = 0;
+volatile int stranger_locked = -1;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ms()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+void record(void *arg)
+{
+    order[order_length++] = *(char *) arg;
+}
+
+void lock_and_record(void *arg)
+{
+    uthread_mutex_lock(&mutex);
+    order[order_length++] = *(char *) arg;
+    uthread_mutex_unlock(&mutex);
+}
+
+void low()
+{
+    int tid = uthread_get_tid();
+    uthread_mutex_lock(&mutex);
+    holding = true;
+    int start = uthread_get_quantums(tid);
+    while (uthread_get_quantums(tid) < start + HOLD_QUANTUMS)
+    {
+        int priority = uthread_get_priority(tid);
+        if (priority > low_highest)
+        {
+            low_highest = priority;
+        }
+    }
+    uthread_mutex_unlock(&mutex);
+    low_after = uthread_get_priority(tid);
+}
+
+void medium()
+{
+    while (!high_done)
+    {}
+}
+
+void high()
+{
+    uthread_mutex_lock(&mutex);
+    high_done = true;
+    uthread_mutex_unlock(&mutex);
+}
+
+// holds the mutex until it is terminated
+void hog()
+{
+    uthread_mutex_lock(&mutex);
+    uthread_block(uthread_get_tid());
+}
+
+// comes after a terminated holder, maybe with its id
+void stranger()
+{
+    stranger_unlocked = uthread_mutex_unlock(&mutex);
+    stranger_locked = uthread_mutex_lock(&mutex);
+    uthread_mutex_unlock(&mutex);
+}
+
+int main()
+{
+    printf(GRN "Test 23:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_set_priority(0, UTHREAD_PRIORITY_LEVELS) != -1 || uthread_set_priority(0, -1) != -1
+        || uthread_get_priority(MAX_THREAD_NUM - 1) != -1)
+    {
+        error("a bad priority or thread was accepted");
+    }
+    // main outranks everyone it spawns, and lets them run only while it sleeps
+    uthread_set_priority(0, TOP);
+
+    char names[] = "abc";
+    int a = uthread_spawn_arg(record, &names[0]);
+    int b = uthread_spawn_arg(record, &names[1]);
+    uthread_spawn_arg(record, &names[2]);
+    uthread_set_priority(b, 5);
+    uthread_set_priority(a, 2);
+    uthread_sleep_us(5000);
+    if (order_length != 3 || order[0] != 'b' || order[1] != 'a' || order[2] != 'c')
+    {
+        error("the READY threads did not run highest priority first");
+    }
+
+    order_length = 0;
+    uthread_mutex_lock(&mutex);
+    int priorities[] = {1, 4, 2};
+    for (int i = 0; i < 3; i++)
+    {
+        uthread_set_priority(uthread_spawn_arg(lock_and_record, &names[i]), priorities[i]);
+    }
+    uthread_sleep_us(5000); // they all park on the mutex
+    uthread_mutex_unlock(&mutex);
+    uthread_sleep_us(5000);
+    if (order_length != 3 || order[0] != 'b' || order[1] != 'c' || order[2] != 'a')
+    {
+        error("the mutex did not wake its most urgent waiter first");
+    }
+
+    int low_tid = uthread_spawn(low);
+    while (!holding)
+    {
+        uthread_sleep_us(1000);
+    }
+    for (int i = 0; i < MEDIUMS; i++)
+    {
+        uthread_set_priority(uthread_spawn(medium), MEDIUM);
+    }
+    uthread_set_priority(uthread_spawn(high), HIGH);
+    double start = now_ms();
+    while (!high_done)
+    {
+        if (now_ms() - start > LIMIT_MS)
+        {
+            error("the medium threads starved the low holder: no inheritance");
+        }
+        uthread_sleep_us(1000);
+    }
+    uthread_sleep_us(5000);
+    if (low_highest != HIGH)
+    {
+        error("the low holder did not run with the waiter's priority");
+    }
+    if (low_after != LOW || uthread_get_priority(low_tid) == HIGH)
+    {
+        error("the low holder kept the inherited priority after unlocking");
+    }
+
+    // a holder terminated with a waiter parked
+    order_length = 0;
+    int hog_tid = uthread_spawn(hog);
+    uthread_sleep_us(2000);
+    uthread_spawn_arg(lock_and_record, &names[0]);
+    uthread_sleep_us(2000);
+    uthread_terminate(hog_tid);
+    uthread_sleep_us(2000);
+    if (order_length != 1)
+    {
+        error("the waiter of a terminated holder did not get the mutex");
+    }
+
+    // a waiter terminated while it lends the holder its priority, then the holder
+    hog_tid = uthread_spawn(hog);
+    uthread_sleep_us(2000);
+    int lender = uthread_spawn_arg(lock_and_record, &names[1]);
+    uthread_set_priority(lender, HIGH);
+    uthread_sleep_us(2000);
+    if (uthread_get_priority(hog_tid) != HIGH)
+    {
+        error("the holder did not inherit from its waiter");
+    }
+    uthread_terminate(lender);
+    if (uthread_get_priority(hog_tid) != LOW)
+    {
+        error("the holder kept the priority of a terminated waiter");
+    }
+    uthread_terminate(hog_tid);
+    uthread_spawn(stranger);
+    uthread_sleep_us(2000);
+    if (stranger_unlocked != -1 || stranger_locked != 0)
+    {
+        error("a terminated holder left its mutex locked");
+    }
+
+    // the waiter woken first is terminated before it runs
+    order_length = 0;
+    uthread_mutex_lock(&mutex);
+    int woken = uthread_spawn_arg(lock_and_record, &names[0]);
+    uthread_set_priority(woken, 4);
+    uthread_spawn_arg(lock_and_record, &names[2]);
+    uthread_sleep_us(2000);
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(woken);
+    uthread_sleep_us(2000);
+    if (order_length != 1 || order[0] != 'c')
+    {
+        error("a woken waiter that was terminated kept the others parked");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
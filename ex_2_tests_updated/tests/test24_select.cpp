@@ -0,0 +1,188 @@
+/**********************************************
+ * Test 24: channels and uthread_select
+ *
+ * a channel keeps its messages in order and parks a sender while it
+ * is full. uthread_select then waits on two channels and a pipe at
+ * once and takes whichever comes first, with every other wait queue
+ * left empty right after; it times out, only checks when the timeout
+ * is 0, waits for room to send, and leaves nothing behind when the
+ * waiting thread is terminated. Bad case lists are refused.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define CAPACITY 4
+#define MESSAGES 20
+#define TIMEOUT_USECS 5000
+
+void *first_slots[CAPACITY], *second_slots[CAPACITY], *small_slots[1];
+uthread_channel_t first = UTHREAD_CHANNEL_INITIALIZER(first_slots, CAPACITY);
+uthread_channel_t second = UTHREAD_CHANNEL_INITIALIZER(second_slots, CAPACITY);
+uthread_channel_t small;
+int pipe_fds[2];
+long message_values[MESSAGES];
+volatile int sent = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_us()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+void producer()
+{
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        uthread_channel_send(&first, &message_values[i]);
+        sent = i + 1;
+    }
+}
+
+void send_second()
+{
+    uthread_sleep_us(3000);
+    uthread_channel_send(&second, &message_values[7]);
+}
+
+void write_pipe()
+{
+    uthread_sleep_us(3000);
+    write(pipe_fds[1], "x", 1);
+}
+
+void receive_small()
+{
+    uthread_sleep_us(3000);
+    void *message;
+    uthread_channel_receive(&small, &message);
+}
+
+void select_forever()
+{
+    uthread_select_case cases[2] = {{UTHREAD_SELECT_RECEIVE, &first, nullptr, -1},
+                                    {UTHREAD_SELECT_READ, nullptr, nullptr, pipe_fds[0]}};
+    uthread_select(cases, 2, -1);
+    error("the select returned with nothing sent");
+}
+
+bool queues_empty()
+{
+    return first.receivers.head == nullptr && first.senders.head == nullptr && second.receivers.head == nullptr
+           && second.senders.head == nullptr && small.senders.head == nullptr;
+}
+
+int main()
+{
+    printf(GRN "Test 24:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (pipe(pipe_fds) != 0)
+    {
+        error("no pipe");
+    }
+
+    // in order, with the producer parked whenever the channel is full
+    uthread_spawn(producer);
+    uthread_sleep_us(3000);
+    if (sent != CAPACITY)
+    {
+        error("a send did not park on a full channel");
+    }
+    for (int i = 0; i < MESSAGES; i++)
+    {
+        void *message;
+        uthread_channel_receive(&first, &message);
+        if (message != &message_values[i])
+        {
+            error("the messages came out of order");
+        }
+    }
+
+    uthread_select_case cases[3] = {{UTHREAD_SELECT_RECEIVE, &first, nullptr, -1},
+                                    {UTHREAD_SELECT_RECEIVE, &second, nullptr, -1},
+                                    {UTHREAD_SELECT_READ, nullptr, nullptr, pipe_fds[0]}};
+    uthread_spawn(send_second);
+    if (uthread_select(cases, 3, -1) != 1 || cases[1].message != &message_values[7])
+    {
+        error("the select did not take the message of the second channel");
+    }
+    if (!queues_empty())
+    {
+        error("the select stayed on another queue");
+    }
+
+    uthread_spawn(write_pipe);
+    if (uthread_select(cases, 3, -1) != 2)
+    {
+        error("the select did not see the pipe become readable");
+    }
+    char byte;
+    read(pipe_fds[0], &byte, 1);
+
+    long long start = now_us();
+    if (uthread_select(cases, 3, TIMEOUT_USECS) != -1 || errno != ETIMEDOUT)
+    {
+        error("the select did not time out");
+    }
+    if (now_us() - start < TIMEOUT_USECS)
+    {
+        error("the select timed out early");
+    }
+    if (!queues_empty())
+    {
+        error("the select stayed on a queue after timing out");
+    }
+    start = now_us();
+    if (uthread_select(cases, 3, 0) != -1 || now_us() - start > TIMEOUT_USECS)
+    {
+        error("a select with a zero timeout did not return at once");
+    }
+
+    uthread_channel_init(&small, small_slots, 1);
+    uthread_channel_send(&small, nullptr);
+    uthread_select_case send_case[1] = {{UTHREAD_SELECT_SEND, &small, &message_values[3], -1}};
+    uthread_spawn(receive_small);
+    if (uthread_select(send_case, 1, -1) != 0 || small.count != 1 || small_slots[small.head] != &message_values[3])
+    {
+        error("the select did not send once there was room");
+    }
+
+    int waiter = uthread_spawn(select_forever);
+    uthread_sleep_us(3000);
+    uthread_terminate(waiter);
+    if (!queues_empty())
+    {
+        error("a terminated select stayed on a queue");
+    }
+
+    uthread_select_case twice[2] = {{UTHREAD_SELECT_RECEIVE, &first, nullptr, -1},
+                                    {UTHREAD_SELECT_RECEIVE, &first, nullptr, -1}};
+    uthread_select_case unknown[1] = {{42, &first, nullptr, -1}};
+    if (uthread_select(twice, 2, 0) != -1 || uthread_select(unknown, 1, 0) != -1
+        || uthread_select(cases, 0, 0) != -1 || uthread_channel_init(&small, small_slots, 0) != -1)
+    {
+        error("bad arguments were accepted");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
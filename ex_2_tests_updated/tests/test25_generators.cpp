@@ -0,0 +1,216 @@
+/**********************************************
+ * Test 25: generators
+ *
+ * a counting generator hands back its values in order and then
+ * reports it finished; a pull-based tokenizer splits a line into
+ * words; a generator resumes another one; generators keep their
+ * values while their threads are preempted and others run theirs.
+ * Yielding outside a generator and resuming a running one are
+ * errors. Ends with the cost of a resume and yield round trip.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define COUNT 10
+#define DRIVERS 4
+#define LONG_COUNT 3000
+#define ROUND_TRIPS 1000000
+
+volatile int drivers_done = 0;
+uthread_generator_t *self_generator;
+volatile int self_resume_result = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+void count(void *arg)
+{
+    long limit = (long) arg;
+    for (long i = 0; i < limit; i++)
+    {
+        uthread_yield_value((void *) i);
+    }
+}
+
+// yields a pointer to each word of line, cut off in place
+void tokenize(void *arg)
+{
+    char *word = (char *) arg;
+    while (*word != '\0')
+    {
+        while (*word == ' ')
+        {
+            word++;
+        }
+        if (*word == '\0')
+        {
+            break;
+        }
+        char *end = word;
+        while (*end != ' ' && *end != '\0')
+        {
+            end++;
+        }
+        bool last = *end == '\0';
+        *end = '\0';
+        uthread_yield_value(word);
+        word = last ? end : end + 1;
+    }
+}
+
+void doubled(void *arg)
+{
+    uthread_generator_t *inner = (uthread_generator_t *) arg;
+    void *value;
+    while (uthread_generator_resume(inner, &value) == 1)
+    {
+        uthread_yield_value((void *) ((long) value * 2));
+    }
+}
+
+void resume_self(void *arg)
+{
+    (void) arg;
+    self_resume_result = uthread_generator_resume(self_generator, nullptr);
+}
+
+void driver()
+{
+    uthread_generator_t *generator = uthread_generator_create(count, (void *) LONG_COUNT, 0);
+    void *value;
+    for (long i = 0; i < LONG_COUNT; i++)
+    {
+        if (uthread_generator_resume(generator, &value) != 1 || (long) value != i)
+        {
+            error("a preempted generator lost its place");
+        }
+        for (volatile int spin = 0; spin < 2000; spin++)
+        {}
+    }
+    if (uthread_generator_resume(generator, &value) != 0)
+    {
+        error("a preempted generator did not finish");
+    }
+    uthread_generator_destroy(generator);
+    drivers_done++;
+}
+
+int main()
+{
+    printf(GRN "Test 25:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_yield_value(nullptr) != -1)
+    {
+        error("yielded outside a generator");
+    }
+    if (uthread_generator_create(count, nullptr, 100) != nullptr || uthread_generator_create(nullptr, nullptr, 0))
+    {
+        error("a generator without a body or stack was created");
+    }
+
+    uthread_generator_t *counter = uthread_generator_create(count, (void *) COUNT, 0);
+    void *value;
+    for (long i = 0; i < COUNT; i++)
+    {
+        if (uthread_generator_resume(counter, &value) != 1 || (long) value != i)
+        {
+            error("the counter yielded a wrong value");
+        }
+    }
+    if (uthread_generator_resume(counter, &value) != 0 || uthread_generator_resume(counter, &value) != 0)
+    {
+        error("the counter did not report it finished");
+    }
+    uthread_generator_destroy(counter);
+
+    char line[] = "  pull  based parsers   run here ";
+    const char *words[] = {"pull", "based", "parsers", "run", "here"};
+    uthread_generator_t *tokenizer = uthread_generator_create(tokenize, line, 0);
+    int amount = 0;
+    while (uthread_generator_resume(tokenizer, &value) == 1)
+    {
+        if (amount == 5 || strcmp((char *) value, words[amount]) != 0)
+        {
+            error("the tokenizer yielded a wrong word");
+        }
+        amount++;
+    }
+    if (amount != 5)
+    {
+        error("the tokenizer missed words");
+    }
+    uthread_generator_destroy(tokenizer);
+
+    uthread_generator_t *inner = uthread_generator_create(count, (void *) COUNT, 0);
+    uthread_generator_t *outer = uthread_generator_create(doubled, inner, 0);
+    for (long i = 0; i < COUNT; i++)
+    {
+        if (uthread_generator_resume(outer, &value) != 1 || (long) value != 2 * i)
+        {
+            error("the nested generators yielded a wrong value");
+        }
+    }
+    if (uthread_generator_resume(outer, &value) != 0)
+    {
+        error("the nested generators did not finish");
+    }
+    uthread_generator_destroy(outer);
+    uthread_generator_destroy(inner);
+
+    self_generator = uthread_generator_create(resume_self, nullptr, 0);
+    uthread_generator_resume(self_generator, nullptr);
+    if (self_resume_result != -1)
+    {
+        error("a running generator was resumed");
+    }
+    uthread_generator_destroy(self_generator);
+
+    // an unfinished generator can be dropped
+    counter = uthread_generator_create(count, (void *) COUNT, 0);
+    uthread_generator_resume(counter, &value);
+    if (uthread_generator_destroy(counter) != 0)
+    {
+        error("a suspended generator was not destroyed");
+    }
+
+    for (int i = 0; i < DRIVERS; i++)
+    {
+        uthread_spawn(driver);
+    }
+    while (drivers_done < DRIVERS)
+    {
+        uthread_sleep_us(1000);
+    }
+
+    counter = uthread_generator_create(count, (void *) ROUND_TRIPS, 0);
+    double start = now_ns();
+    while (uthread_generator_resume(counter, &value) == 1)
+    {}
+    double per_trip = (now_ns() - start) / ROUND_TRIPS;
+    uthread_generator_destroy(counter);
+
+    printf(GRN "SUCCESS" RESET " (%.0f ns per resume and yield)\n", per_trip);
+    uthread_terminate(0);
+}
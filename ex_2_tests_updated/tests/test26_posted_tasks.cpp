@@ -0,0 +1,184 @@
+/**********************************************
+ * Test 26: posted tasks
+ *
+ * tasks run in the order they were posted, on no thread, and only
+ * between thread slices; the queue refuses a post once it is full;
+ * with a thread spinning all along they get about the share of the
+ * CPU they were given, and none at share 0. Ends with how many
+ * self-posting tiny tasks run per second.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define ORDERED 1000
+#define SHARE 25
+#define WINDOW_MS 300
+#define CHAINS 64
+#define TINY_TASKS 2000000
+
+volatile int ran = 0;
+volatile bool out_of_order = false;
+volatile bool in_a_thread = false;
+volatile bool spinning = true;
+volatile long long task_ns = 0;
+volatile long tiny_left = TINY_TASKS;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+long long now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+void ordered(void *arg)
+{
+    if ((long) arg != ran)
+    {
+        out_of_order = true;
+    }
+    if (uthread_in_thread())
+    {
+        in_a_thread = true;
+    }
+    ran++;
+}
+
+void nothing(void *arg)
+{
+    (void) arg;
+}
+
+// about 20 us of work, timed, then posts itself again
+void timed(void *arg)
+{
+    long long start = now_ns();
+    while (now_ns() - start < 20000)
+    {}
+    task_ns += now_ns() - start;
+    ran++;
+    if (spinning)
+    {
+        uthread_post(timed, arg);
+    }
+}
+
+void tiny(void *arg)
+{
+    if (--tiny_left > 0)
+    {
+        uthread_post(tiny, arg);
+    }
+}
+
+void spinner()
+{
+    while (spinning)
+    {}
+}
+
+// the fraction of WINDOW_MS the tasks got while a thread spun all along
+double share_taken(int share)
+{
+    uthread_set_task_share(share);
+    spinning = true;
+    ran = 0;
+    task_ns = 0;
+    uthread_spawn(spinner);
+    for (int i = 0; i < 4; i++)
+    {
+        uthread_post(timed, nullptr);
+    }
+    uthread_sleep_us(WINDOW_MS * 1000);
+    long long taken = task_ns;
+    spinning = false;
+    uthread_sleep_us(5000); // the spinner ends, the last tasks stop posting
+    return (double) taken / (WINDOW_MS * 1000000.0);
+}
+
+int main()
+{
+    printf(GRN "Test 26:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_post(nullptr, nullptr) != -1 || uthread_set_task_share(101) != -1
+        || uthread_set_task_share(-1) != -1)
+    {
+        error("bad arguments were accepted");
+    }
+
+    for (long i = 0; i < ORDERED; i++)
+    {
+        uthread_post(ordered, (void *) i);
+    }
+    uthread_sleep_us(5000);
+    if (ran != ORDERED || out_of_order)
+    {
+        error("the tasks did not all run in order");
+    }
+    if (in_a_thread)
+    {
+        error("a task ran as a thread");
+    }
+
+    // at share 0 main keeps the CPU while it is READY, so nothing runs them
+    uthread_set_task_share(0);
+    for (int i = 0; i < MAX_POSTED_TASKS; i++)
+    {
+        if (uthread_post(nothing, nullptr) != 0)
+        {
+            error("a post was refused before the queue was full");
+        }
+    }
+    if (uthread_post(nothing, nullptr) != -1)
+    {
+        error("a post was taken by a full queue");
+    }
+    uthread_sleep_us(5000);
+    if (uthread_post(nothing, nullptr) != 0)
+    {
+        error("the queue did not drain while main slept");
+    }
+    uthread_sleep_us(5000);
+
+    if (share_taken(0) != 0)
+    {
+        error("tasks ran at share 0 while a thread was READY");
+    }
+    double taken = share_taken(SHARE);
+    if (taken < SHARE / 100.0 / 2 || taken > SHARE / 100.0 * 1.5)
+    {
+        printf("(took %.2f of the CPU) ", taken);
+        error("the tasks did not get about their share");
+    }
+
+    uthread_set_task_share(50);
+    long long start = now_ns();
+    for (int i = 0; i < CHAINS; i++)
+    {
+        uthread_post(tiny, nullptr);
+    }
+    while (tiny_left > 0)
+    {
+        uthread_sleep_us(1000);
+    }
+    double per_second = TINY_TASKS / ((now_ns() - start) / 1e9);
+
+    printf(GRN "SUCCESS" RESET " (%.1f million tiny tasks per second)\n", per_second / 1e6);
+    uthread_terminate(0);
+}
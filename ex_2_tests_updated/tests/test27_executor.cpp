@@ -0,0 +1,215 @@
+/**********************************************
+ * Test 27: executors and futures
+ *
+ * many times more work items than there are thread ids run on a
+ * few workers, every future gets its own result, several threads
+ * can wait on one future, a submitter parks while the queue is
+ * full, work without a future runs as well, and shutting down
+ * runs whatever is still queued before the workers end and their
+ * ids come free again, while a submitter still parked on a full
+ * queue fails and keeps its future as it was. Workers cannot be
+ * terminated on their own.
+ * Ends with the cost of a submitted item.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define WORKERS 4
+#define CAPACITY 16
+#define ITEMS 2000
+#define FUTURE_WAITERS 5
+#define QUEUED_AT_SHUTDOWN 50
+#define TIMED_ITEMS 100000
+
+uthread_future_t futures[ITEMS];
+volatile bool worker_ids[MAX_THREAD_NUM];
+volatile int fire_and_forget = 0;
+uthread_future_t shared;
+volatile bool release_slow = false;
+volatile int shared_seen = 0;
+uthread_executor_t *small;
+uthread_future_t untouched;
+volatile int late_submitted = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+void *square(void *arg)
+{
+    worker_ids[uthread_get_tid()] = true;
+    long x = (long) arg;
+    for (volatile int i = 0; i < 200; i++)
+    {}
+    return (void *) (x * x);
+}
+
+void *count_up(void *arg)
+{
+    (void) arg;
+    fire_and_forget++;
+    return nullptr;
+}
+
+void *slow_answer(void *arg)
+{
+    while (!release_slow)
+    {
+        uthread_sleep_us(1000);
+    }
+    return arg;
+}
+
+void *nothing(void *arg)
+{
+    return arg;
+}
+
+void shared_waiter()
+{
+    void *result;
+    uthread_future_wait(&shared, &result);
+    if ((long) result != 42)
+    {
+        error("a waiter got a wrong result");
+    }
+    shared_seen++;
+}
+
+// parks on the full queue of small until it shuts down, then lets its work go on
+void late_submitter()
+{
+    late_submitted = uthread_executor_submit(small, nothing, nullptr, &untouched);
+    release_slow = true;
+}
+
+int main()
+{
+    printf(GRN "Test 27:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    if (uthread_executor_create(0, CAPACITY) != nullptr || uthread_executor_create(MAX_THREAD_NUM, CAPACITY) != nullptr)
+    {
+        error("an executor without workers or ids was created");
+    }
+
+    uthread_executor_t *executor = uthread_executor_create(WORKERS, CAPACITY);
+    if (uthread_executor_submit(executor, nullptr, nullptr, nullptr) != -1)
+    {
+        error("work that is missing was submitted");
+    }
+    // far more items than the queue holds: main parks whenever it is full
+    for (long i = 0; i < ITEMS; i++)
+    {
+        uthread_executor_submit(executor, square, (void *) i, &futures[i]);
+    }
+    for (long i = 0; i < ITEMS; i++)
+    {
+        void *result;
+        uthread_future_wait(&futures[i], &result);
+        if ((long) result != i * i)
+        {
+            error("a future got a wrong result");
+        }
+    }
+    int used = 0;
+    for (int tid = 0; tid < MAX_THREAD_NUM; tid++)
+    {
+        used += worker_ids[tid];
+    }
+    if (worker_ids[0] || used > WORKERS)
+    {
+        error("the work did not run on the workers alone");
+    }
+    for (int tid = 1; tid < MAX_THREAD_NUM; tid++)
+    {
+        if (worker_ids[tid] && uthread_terminate(tid) != -1)
+        {
+            error("a worker was terminated while its executor lived");
+        }
+    }
+
+    uthread_executor_submit(executor, slow_answer, (void *) 42, &shared);
+    for (int i = 0; i < FUTURE_WAITERS; i++)
+    {
+        uthread_spawn(shared_waiter);
+    }
+    uthread_sleep_us(5000);
+    if (shared_seen != 0 || shared.done)
+    {
+        error("a future was done before its work");
+    }
+    release_slow = true;
+    while (shared_seen < FUTURE_WAITERS)
+    {
+        uthread_sleep_us(1000);
+    }
+
+    double start = now_ns();
+    for (long i = 0; i < TIMED_ITEMS; i++)
+    {
+        uthread_executor_submit(executor, nothing, nullptr, nullptr);
+    }
+    uthread_future_t last;
+    uthread_executor_submit(executor, nothing, nullptr, &last);
+    uthread_future_wait(&last, nullptr);
+    double per_item = (now_ns() - start) / TIMED_ITEMS;
+
+    for (int i = 0; i < QUEUED_AT_SHUTDOWN; i++)
+    {
+        uthread_executor_submit(executor, count_up, nullptr, nullptr);
+    }
+    if (uthread_executor_shutdown(executor) != 0 || fire_and_forget != QUEUED_AT_SHUTDOWN)
+    {
+        error("shutting down did not run the queued work");
+    }
+
+    // the slow item keeps the only worker busy and count_up fills the queue
+    release_slow = false;
+    int ran_before = fire_and_forget;
+    small = uthread_executor_create(1, 1);
+    uthread_executor_submit(small, slow_answer, nullptr, nullptr);
+    uthread_executor_submit(small, count_up, nullptr, nullptr);
+    untouched.done = 1;
+    untouched.result = (void *) 7;
+    uthread_spawn(late_submitter);
+    uthread_sleep_us(5000);
+    if (uthread_executor_shutdown(small) != 0 || fire_and_forget != ran_before + 1)
+    {
+        error("shutting down with a parked submitter did not run the queued work");
+    }
+    if (late_submitted != -1 || untouched.done != 1 || (long) untouched.result != 7)
+    {
+        error("a submitter parked at shutdown did not fail and leave its future");
+    }
+    uthread_sleep_us(5000);
+    // the workers' ids are free again
+    executor = uthread_executor_create(MAX_THREAD_NUM - 1 - FUTURE_WAITERS, 1);
+    if (executor == nullptr)
+    {
+        error("the workers of a shut down executor kept their ids");
+    }
+    uthread_executor_shutdown(executor);
+
+    printf(GRN "SUCCESS" RESET " (%.0f ns per submitted item)\n", per_item);
+    uthread_terminate(0);
+}
@@ -0,0 +1,226 @@
+/**********************************************
+ * Test 28: typed futures and promises
+ *
+ * threads waiting on a future park until another thread sets the
+ * promise and then all see its value; a ready future returns at
+ * once; continuations run as tasks, on no thread, in a chain, also
+ * when added after the value; a struct and a string go through as
+ * well, a promise takes one value and one continuation, and setting
+ * and getting allocates nothing. A promise that goes out of scope
+ * right after starting its continuation waits for it, with freed
+ * memory poisoned to catch a continuation running on a dead one.
+ * Ends with the cost of a hand-off from one thread to another.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include "../uthreads.h"
+#include "../uthreads_future.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define WAITERS 10
+#define HAND_OFFS 100000
+
+struct point
+{
+    long x, y, z, w;
+};
+
+volatile long allocations = 0;
+uthread::promise<int> answer;
+volatile int answers_seen = 0;
+volatile int scoped_result = 0;
+volatile bool scoped_done = false;
+volatile bool continuation_in_thread = false;
+uthread::promise<point> corner;
+uthread::promise<long> *hand_offs;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *memory = malloc(size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void *memory) noexcept
+{
+    if (memory != nullptr)
+    {
+        memset(memory, 0xdd, malloc_usable_size(memory));
+    }
+    free(memory);
+}
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+void waiter()
+{
+    if (answer.get_future().get() != 42)
+    {
+        error("a waiter got a wrong value");
+    }
+    answers_seen++;
+}
+
+void set_corner()
+{
+    uthread_sleep_us(2000);
+    corner.set_value(point{1, 2, 3, 4});
+}
+
+// its promise ends while the continuation is still only posted
+void scoped_promise()
+{
+    {
+        uthread::promise<int> local;
+        local.get_future().then([](const int &x) {
+            scoped_result = x + 1;
+            return x;
+        });
+        local.set_value(5);
+    }
+    if (scoped_result != 6)
+    {
+        error("a promise ended before its continuation ran");
+    }
+    scoped_done = true;
+}
+
+// sets the promises in order while main waits on them one by one
+void hand_over()
+{
+    for (long i = 0; i < HAND_OFFS; i++)
+    {
+        hand_offs[i].set_value(i);
+    }
+}
+
+int main()
+{
+    printf(GRN "Test 28:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+
+    for (int i = 0; i < WAITERS; i++)
+    {
+        uthread_spawn(waiter);
+    }
+    uthread_sleep_us(5000);
+    if (answers_seen != 0 || answer.get_future().ready())
+    {
+        error("a waiter did not park");
+    }
+    if (answer.set_value(42) != 0 || answer.set_value(7) != -1)
+    {
+        error("a promise did not take exactly one value");
+    }
+    uthread_sleep_us(5000);
+    if (answers_seen != WAITERS || answer.get_future().get() != 42)
+    {
+        error("not every waiter saw the value");
+    }
+
+    long before = allocations;
+    uthread_spawn(set_corner);
+    point p = corner.get_future().get();
+    if (p.x != 1 || p.w != 4)
+    {
+        error("the struct came out wrong");
+    }
+    if (allocations != before)
+    {
+        error("setting and getting a value allocated");
+    }
+
+    uthread::promise<std::string> word;
+    word.set_value("apples");
+    if (word.get_future().get() != "apples")
+    {
+        error("the string came out wrong");
+    }
+
+    // a chain added before the value; continuations are tasks, so they do not allocate
+    uthread::promise<int> start;
+    uthread::future<double> half = start.get_future()
+        .then([](const int &x) {
+            continuation_in_thread |= uthread_in_thread() != 0;
+            return x * 2;
+        })
+        .then([](const int &x) { return x + 0.5; });
+    if (half.ready())
+    {
+        error("a continuation ran before the value");
+    }
+    start.set_value(21);
+    if (half.get() != 42.5)
+    {
+        error("the chain gave a wrong value");
+    }
+    if (continuation_in_thread)
+    {
+        error("a continuation ran as a thread");
+    }
+    if (start.get_future().then([](const int &x) { return x; }).valid())
+    {
+        error("a promise took a second continuation");
+    }
+
+    // added after the value, it still runs
+    uthread::future<long> late = corner.get_future().then([](const point &q) { return q.x + q.y + q.z + q.w; });
+    if (late.get() != 10)
+    {
+        error("a late continuation gave a wrong value");
+    }
+    if (corner.get_future().then([](const point &q) { return q.x; }).valid())
+    {
+        error("a promise took a second continuation after its value");
+    }
+
+    uthread_spawn(scoped_promise);
+    while (!scoped_done)
+    {
+        uthread_sleep_us(1000);
+    }
+
+    hand_offs = new uthread::promise<long>[HAND_OFFS];
+    uthread_spawn(hand_over);
+    double begin = now_ns();
+    for (long i = 0; i < HAND_OFFS; i++)
+    {
+        if (hand_offs[i].get_future().get() != i)
+        {
+            error("a hand-off gave a wrong value");
+        }
+    }
+    double per_hand_off = (now_ns() - begin) / HAND_OFFS;
+    delete[] hand_offs;
+
+    printf(GRN "SUCCESS" RESET " (%.0f ns per hand-off)\n", per_hand_off);
+    uthread_terminate(0);
+}
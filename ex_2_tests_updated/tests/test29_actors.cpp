@@ -0,0 +1,237 @@
+/**********************************************
+ * Test 29: actors
+ *
+ * an actor gets its messages in order, in batches no longer than
+ * the system's batch, only on the system's workers and never on two
+ * of them at once, while a slow actor does not hold up the others;
+ * actors pass a token around a ring, workers cannot be terminated
+ * on their own, and shutting down waits until every mailbox is
+ * empty. Ends with a million actors, each sent a message, and the
+ * cost per message.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define WORKERS 4
+#define BATCH 16
+#define MESSAGES 1000
+#define SLOW_MESSAGES 10
+#define RING 100
+#define LAPS 50
+#define MANY_ACTORS 1000000
+
+struct counter
+{
+    long received; // the data of the next message in order
+    int batches;
+    int longest_batch;
+    bool out_of_order;
+};
+
+volatile bool worker_ids[MAX_THREAD_NUM];
+volatile bool slow_running = false;
+volatile bool overlapped = false;
+volatile int slow_handled = 0;
+volatile long hops = 0;
+uthread_actor_t ring[RING];
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+double now_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+void count_messages(uthread_actor_t *actor, uthread_message_t *batch)
+{
+    worker_ids[uthread_get_tid()] = true;
+    counter *state = (counter *) actor->state;
+    int length = 0;
+    for (uthread_message_t *message = batch; message != nullptr; message = message->next)
+    {
+        if ((long) message->data != state->received)
+        {
+            state->out_of_order = true;
+        }
+        state->received++;
+        length++;
+    }
+    state->batches++;
+    if (length > state->longest_batch)
+    {
+        state->longest_batch = length;
+    }
+}
+
+// parks in its behavior, one message at a time
+void slow(uthread_actor_t *actor, uthread_message_t *batch)
+{
+    (void) actor;
+    for (uthread_message_t *message = batch; message != nullptr; message = message->next)
+    {
+        if (slow_running)
+        {
+            overlapped = true;
+        }
+        slow_running = true;
+        uthread_sleep_us(2000);
+        slow_running = false;
+        slow_handled++;
+    }
+}
+
+// sends the token on to the next actor of the ring until it has gone LAPS times around
+void pass_on(uthread_actor_t *actor, uthread_message_t *batch)
+{
+    while (batch != nullptr)
+    {
+        uthread_message_t *message = batch;
+        batch = batch->next;
+        if (++hops < RING * LAPS)
+        {
+            uthread_actor_send(&ring[((long) actor->state + 1) % RING], message);
+        }
+    }
+}
+
+void increment(uthread_actor_t *actor, uthread_message_t *batch)
+{
+    for (; batch != nullptr; batch = batch->next)
+    {
+        (*(char *) actor->state)++;
+    }
+}
+
+int main()
+{
+    printf(GRN "Test 29:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    uthread_actor_t actor;
+    uthread_message_t message;
+    if (uthread_actor_system_create(0, BATCH) != nullptr || uthread_actor_system_create(WORKERS, 0) != nullptr
+        || uthread_actor_system_create(MAX_THREAD_NUM, BATCH) != nullptr
+        || uthread_actor_init(&actor, nullptr, count_messages, nullptr) != -1
+        || uthread_actor_send(nullptr, &message) != -1 || uthread_actor_system_shutdown(nullptr) != -1)
+    {
+        error("bad arguments were accepted");
+    }
+
+    uthread_actor_system_t *system = uthread_actor_system_create(WORKERS, BATCH);
+    if (uthread_actor_init(&actor, system, nullptr, nullptr) != -1)
+    {
+        error("an actor without a behavior was set up");
+    }
+
+    // the slow actor keeps a worker busy while the counter gets its messages
+    uthread_actor_t slow_actor;
+    uthread_message_t slow_messages[SLOW_MESSAGES];
+    uthread_actor_init(&slow_actor, system, slow, nullptr);
+    for (int i = 0; i < SLOW_MESSAGES; i++)
+    {
+        uthread_actor_send(&slow_actor, &slow_messages[i]);
+    }
+    counter state = {0, 0, 0, false};
+    uthread_message_t *messages = new uthread_message_t[MESSAGES];
+    uthread_actor_init(&actor, system, count_messages, &state);
+    for (long i = 0; i < MESSAGES; i++)
+    {
+        messages[i].data = (void *) i;
+        uthread_actor_send(&actor, &messages[i]);
+    }
+    while (state.received < MESSAGES)
+    {
+        uthread_sleep_us(1000);
+    }
+    if (slow_handled == SLOW_MESSAGES)
+    {
+        error("the slow actor held up the others");
+    }
+    if (state.out_of_order || state.longest_batch > BATCH || state.batches < MESSAGES / BATCH)
+    {
+        error("the messages did not come in order and in batches");
+    }
+    if (state.longest_batch < 2)
+    {
+        error("the messages were not batched");
+    }
+
+    for (long i = 0; i < RING; i++)
+    {
+        uthread_actor_init(&ring[i], system, pass_on, (void *) i);
+    }
+    uthread_message_t token;
+    uthread_actor_send(&ring[0], &token);
+
+    for (int tid = 1; tid < MAX_THREAD_NUM; tid++)
+    {
+        if (worker_ids[tid] && uthread_terminate(tid) != -1)
+        {
+            error("a worker was terminated while its system lived");
+        }
+    }
+    if (uthread_actor_system_shutdown(system) != 0)
+    {
+        error("the system did not shut down");
+    }
+    if (slow_handled != SLOW_MESSAGES || hops != RING * LAPS)
+    {
+        error("shutting down did not wait for every mailbox");
+    }
+    if (overlapped)
+    {
+        error("an actor ran on two workers at once");
+    }
+    int used = 0;
+    for (int tid = 0; tid < MAX_THREAD_NUM; tid++)
+    {
+        used += worker_ids[tid];
+    }
+    if (worker_ids[0] || used > WORKERS)
+    {
+        error("the actors did not run on the workers alone");
+    }
+    delete[] messages;
+
+    uthread_actor_t *actors = new uthread_actor_t[MANY_ACTORS];
+    uthread_message_t *mail = new uthread_message_t[MANY_ACTORS];
+    char *counts = new char[MANY_ACTORS]();
+    system = uthread_actor_system_create(WORKERS, BATCH);
+    double start = now_ns();
+    for (long i = 0; i < MANY_ACTORS; i++)
+    {
+        uthread_actor_init(&actors[i], system, increment, &counts[i]);
+        uthread_actor_send(&actors[i], &mail[i]);
+    }
+    uthread_actor_system_shutdown(system);
+    double per_message = (now_ns() - start) / MANY_ACTORS;
+    for (long i = 0; i < MANY_ACTORS; i++)
+    {
+        if (counts[i] != 1)
+        {
+            error("an actor of the million did not get its message");
+        }
+    }
+    delete[] actors;
+    delete[] mail;
+    delete[] counts;
+
+    printf(GRN "SUCCESS" RESET " (%.0f ns per message to a million actors)\n", per_message);
+    uthread_terminate(0);
+}
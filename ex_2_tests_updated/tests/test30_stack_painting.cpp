@@ -0,0 +1,185 @@
+/**********************************************
+ * Test 30: stack painting
+ *
+ * threads spawned while painting is off, and main, have no
+ * high-water mark; painted threads that touch known amounts of
+ * stack report marks that fit them, next to one that only parks;
+ * once they end the report groups them by entry point with the
+ * deepest mark, the number of threads and the matching size class.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define QUANTUM_USECS 1000
+#define SHALLOW_BYTES 128
+#define DEEP_BYTES 3072
+#define FRAME_SLACK 512 /* what the frames around a buffer may take besides it */
+#define SHALLOW_THREADS 3
+
+struct usage
+{
+    int samples;
+    int max_used;
+    int size_class;
+};
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+// writes all of a buffer of bytes on the stack
+template<int bytes>
+void touch()
+{
+    volatile char buffer[bytes];
+    (void) buffer;
+    for (int i = 0; i < bytes; i++)
+    {
+        buffer[i] = (char) i;
+    }
+}
+
+// touches the stack, then waits for main to look at it
+void shallow()
+{
+    touch<SHALLOW_BYTES>();
+    uthread_block(uthread_get_tid());
+    uthread_terminate(uthread_get_tid());
+}
+
+void deep()
+{
+    touch<DEEP_BYTES>();
+    uthread_block(uthread_get_tid());
+    uthread_terminate(uthread_get_tid());
+}
+
+// only parks, which takes the library some stack of its own
+void parked()
+{
+    uthread_block(uthread_get_tid());
+}
+
+// the power of two from 1024 up that holds used and a quarter more
+int size_class(int used)
+{
+    int size = 1024;
+    while (size < used + used / 4)
+    {
+        size *= 2;
+    }
+    return size;
+}
+
+// runs uthread_stack_report into a file and reads back the line of entry_point and the recommended size
+usage report_line(thread_entry_point entry_point, int *recommended)
+{
+    char name[] = "/tmp/uthreads_stack_reportXXXXXX";
+    int fd = mkstemp(name);
+    fflush(stdout);
+    int saved = dup(1);
+    dup2(fd, 1);
+    uthread_stack_report();
+    dup2(saved, 1);
+    close(saved);
+
+    char wanted[64];
+    snprintf(wanted, sizeof(wanted), "entry point: %p,", (void *) entry_point);
+    usage found = {0, 0, 0};
+    FILE *report = fopen(name, "r");
+    char line[256];
+    while (fgets(line, sizeof(line), report) != nullptr)
+    {
+        if (strncmp(line, wanted, strlen(wanted)) == 0)
+        {
+            sscanf(line + strlen(wanted), " samples: %d, max used: %d, class: %d", &found.samples, &found.max_used,
+                   &found.size_class);
+        }
+        sscanf(line, "recommended STACK_SIZE: %d", recommended);
+    }
+    fclose(report);
+    close(fd);
+    unlink(name);
+    return found;
+}
+
+int main()
+{
+    printf(GRN "Test 30:   " RESET);
+    fflush(stdout);
+
+    uthread_init(QUANTUM_USECS);
+    int unpainted = uthread_spawn(parked);
+    uthread_sleep_us(2000);
+    if (uthread_get_stack_usage(0) != -1 || uthread_get_stack_usage(unpainted) != -1
+        || uthread_get_stack_usage(MAX_THREAD_NUM) != -1)
+    {
+        error("a thread that was not painted had a high-water mark");
+    }
+    uthread_terminate(unpainted);
+
+    uthread_stack_painting(1);
+    int parked_tid = uthread_spawn(parked);
+    int shallow_tid = uthread_spawn(shallow);
+    int deep_tid = uthread_spawn(deep);
+    uthread_sleep_us(5000);
+    int parked_used = uthread_get_stack_usage(parked_tid);
+    int shallow_used = uthread_get_stack_usage(shallow_tid);
+    int deep_used = uthread_get_stack_usage(deep_tid);
+    if (parked_used <= 0 || shallow_used < SHALLOW_BYTES || shallow_used > parked_used + SHALLOW_BYTES + FRAME_SLACK)
+    {
+        error("the shallow thread's mark does not fit what it touched");
+    }
+    if (deep_used < DEEP_BYTES || deep_used > DEEP_BYTES + FRAME_SLACK || deep_used >= STACK_SIZE)
+    {
+        error("the deep thread's mark does not fit what it touched");
+    }
+    uthread_terminate(parked_tid);
+
+    uthread_resume(shallow_tid);
+    uthread_resume(deep_tid);
+    int more[SHALLOW_THREADS - 1];
+    for (int i = 0; i < SHALLOW_THREADS - 1; i++)
+    {
+        more[i] = uthread_spawn(shallow);
+    }
+    uthread_sleep_us(5000);
+    for (int i = 0; i < SHALLOW_THREADS - 1; i++)
+    {
+        uthread_resume(more[i]);
+    }
+    uthread_sleep_us(5000);
+    uthread_stack_painting(0);
+
+    int recommended = 0;
+    usage shallow_usage = report_line(shallow, &recommended);
+    usage deep_usage = report_line(deep, &recommended);
+    if (shallow_usage.samples != SHALLOW_THREADS || deep_usage.samples != 1)
+    {
+        error("the report did not count the threads of each entry point");
+    }
+    if (shallow_usage.max_used < shallow_used || shallow_usage.max_used > parked_used + SHALLOW_BYTES + FRAME_SLACK
+        || deep_usage.max_used != deep_used)
+    {
+        error("the report did not keep the deepest mark of each entry point");
+    }
+    if (shallow_usage.size_class != size_class(shallow_usage.max_used)
+        || deep_usage.size_class != size_class(deep_used) || recommended != size_class(deep_used))
+    {
+        error("the report recommended a wrong size class");
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
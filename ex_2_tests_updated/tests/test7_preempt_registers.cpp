@@ -0,0 +1,89 @@
+/**********************************************
+ * Test 7: registers survive preemption
+ *
+ * threads spin on floating point counters that only the compiler
+ * keeps in vector registers. A preemption that loses any of them
+ * makes the float value drift away from the integer counter.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define NUM_THREADS 4
+#define QUANTUMS_TO_RUN 200
+
+volatile long counters[NUM_THREADS];
+
+void error()
+{
+    printf(RED "ERROR - register lost on preemption\n" RESET);
+    exit(1);
+}
+
+void spin(int tid)
+{
+    double x = 0;
+    while (true)
+    {
+        x += 1.0;
+        counters[tid]++;
+        if (x != (double) counters[tid])
+        {
+            error();
+        }
+    }
+}
+
+void thread1()
+{
+    spin(1);
+}
+
+void thread2()
+{
+    spin(2);
+}
+
+void thread3()
+{
+    spin(3);
+}
+
+int main()
+{
+    printf(GRN "Test 7:    " RESET);
+    fflush(stdout);
+
+    uthread_init(1000);
+    uthread_spawn(thread1);
+    uthread_spawn(thread2);
+    uthread_spawn(thread3);
+
+    double x = 0;
+    while (uthread_get_total_quantums() < QUANTUMS_TO_RUN)
+    {
+        x += 1.0;
+        counters[0]++;
+        if (x != (double) counters[0])
+        {
+            error();
+        }
+    }
+
+    for (int i = 1; i < NUM_THREADS; i++)
+    {
+        if (counters[i] == 0)
+        {
+            printf(RED "ERROR - thread %d never ran\n" RESET, i);
+            exit(1);
+        }
+    }
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -0,0 +1,87 @@
+/**********************************************
+ * Test 8: short lived workers terminate themselves
+ *
+ * main keeps spawning batches of workers. Half of them end with
+ * uthread_terminate(uthread_get_tid()), half simply return, and
+ * every other batch is killed by main before it gets to run.
+ * Every worker must run exactly once and no tid may leak.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define BATCH 50
+#define ROUNDS 200
+
+volatile int finished = 0;
+
+void error(const char *what)
+{
+    printf(RED "ERROR - %s\n" RESET, what);
+    exit(1);
+}
+
+void wait_next_quantum()
+{
+    int quantum = uthread_get_quantums(uthread_get_tid());
+    while (uthread_get_quantums(uthread_get_tid()) == quantum)
+    {}
+    return;
+}
+
+void terminating_worker()
+{
+    finished++;
+    uthread_terminate(uthread_get_tid());
+    error("terminate returned to a dead thread");
+}
+
+void returning_worker()
+{
+    finished++;
+}
+
+int main()
+{
+    printf(GRN "Test 8:    " RESET);
+    fflush(stdout);
+
+    uthread_init(100);
+
+    int expected = 0;
+    int tids[BATCH];
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int i = 0; i < BATCH; i++)
+        {
+            tids[i] = uthread_spawn(i % 2 ? terminating_worker : returning_worker);
+            if (tids[i] == -1)
+            {
+                error("spawn failed, tids leaked");
+            }
+        }
+        if (round % 2)
+        {
+            // mass termination before the batch ever ran
+            for (int i = 0; i < BATCH; i++)
+            {
+                uthread_terminate(tids[i]);
+            }
+            continue;
+        }
+        expected += BATCH;
+        while (finished != expected)
+        {
+            wait_next_quantum();
+        }
+    }
+
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
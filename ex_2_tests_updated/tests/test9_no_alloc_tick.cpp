@@ -0,0 +1,178 @@
+/**********************************************
+ * Test 9: ticks and context switches never allocate
+ *
+ * malloc and friends are interposed by this file and count their
+ * calls. Once every thread has been spawned and stdout has its
+ * buffer, the threads keep being preempted, sleep, block and
+ * resume each other for a while, and short lived workers exit and
+ * are respawned. The number of allocations made during that
+ * window must be zero. Before it, main twice fills every free id
+ * and terminates the threads before a switch, so more stacks are
+ * around than there are ids; none may be freed, then or later.
+ *
+ **********************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../uthreads.h"
+
+#define GRN "\e[32m"
+#define RED "\x1B[31m"
+#define RESET "\x1B[0m"
+
+#define NUM_THREADS 8
+#define QUANTUMS_TO_RUN 300
+#define BURST (MAX_THREAD_NUM - NUM_THREADS - 1) /* every id left besides the worker's */
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+volatile long allocations = 0;
+volatile long frees = 0;
+
+extern "C" void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size)
+{
+    allocations++;
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    allocations++;
+    *memptr = __libc_memalign(alignment, size);
+    return *memptr == nullptr;
+}
+
+extern "C" void free(void *ptr)
+{
+    if (ptr != nullptr)
+    {
+        frees++;
+    }
+    __libc_free(ptr);
+}
+
+void sleeper()
+{
+    while (true)
+    {
+        uthread_sleep(1 + uthread_get_tid() % 3);
+    }
+}
+
+void blocker()
+{
+    while (true)
+    {
+        uthread_block(uthread_get_tid());
+    }
+}
+
+void spinner()
+{
+    while (true)
+    {
+        // keep the blockers coming back
+        for (int tid = 1; tid < NUM_THREADS; tid++)
+        {
+            uthread_resume(tid);
+        }
+    }
+}
+
+void parked()
+{
+    uthread_block(uthread_get_tid());
+}
+
+volatile int exited = 0;
+
+void worker()
+{
+    exited++;
+}
+
+int main()
+{
+    printf(GRN "Test 9:    " RESET);
+    fflush(stdout);
+
+    uthread_init(200);
+    for (int i = 1; i < NUM_THREADS; i++)
+    {
+        switch (i % 3)
+        {
+            case 0:
+                uthread_spawn(sleeper);
+                break;
+            case 1:
+                uthread_spawn(blocker);
+                break;
+            default:
+                uthread_spawn(spinner);
+                break;
+        }
+    }
+
+    // let every thread run once and a first worker come and go, so lazy
+    // allocations are out of the way
+    uthread_spawn(worker);
+    int start = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < start + NUM_THREADS * 2 || exited == 0)
+    {}
+
+    long frees_before = frees;
+    int burst[BURST];
+    for (int round = 0; round < 2; round++)
+    {
+        for (int i = 0; i < BURST; i++)
+        {
+            burst[i] = uthread_spawn(parked);
+        }
+        for (int i = 0; i < BURST; i++)
+        {
+            uthread_terminate(burst[i]);
+        }
+    }
+
+    long allocations_before = allocations;
+    start = uthread_get_total_quantums();
+    int spawned = exited;
+    while (uthread_get_total_quantums() < start + QUANTUMS_TO_RUN)
+    {
+        if (exited == spawned)
+        {
+            uthread_spawn(worker);
+            spawned++;
+        }
+    }
+    long allocated = allocations - allocations_before;
+    long freed = frees - frees_before;
+
+    if (allocated != 0 || freed != 0)
+    {
+        printf(RED "ERROR - %ld allocations and %ld frees during ticks\n" RESET,
+               allocated, freed);
+        exit(1);
+    }
+    printf(GRN "SUCCESS\n" RESET);
+    uthread_terminate(0);
+}
@@ -2,6 +2,9 @@
 #include <sys/time.h>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cpuid.h>
+#include <ucontext.h>
 #include "uthreads.h"
 #include <csetjmp>
 #include <csignal>
@@ -10,6 +13,14 @@
 #include <algorithm>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <climits>
 #include <iostream>
 
 #define FAIL -1
@@ -18,7 +29,28 @@
 #define JB_SP 6
 #define JB_PC 7
 
-typedef void (*sig_handler) (int);
+#define SCHEDULER_STACK_SIZE 65536 /* the scheduler context's own stack */
+#define SIGNAL_STACK_SIZE 65536 /* sigaltstack on which on_tick runs */
+#define RED_ZONE_SIZE 128 /* bytes below %rsp a leaf function may use */
+#define FXSAVE_SIZE 512
+#define MAX_IO_EVENTS MAX_THREAD_NUM /* readiness events taken per epoll_wait */
+#define URING_ENTRIES MAX_THREAD_NUM /* a thread has one file request at most */
+#define MAX_DEADLINES (MAX_THREAD_NUM + MAX_TIMER_NUM)
+#define TIMER_ID(timer) (MAX_THREAD_NUM + (timer)) /* a timer's deadline owner */
+
+#ifndef sigev_notify_thread_id /* glibc before 2.35 */
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define STACK_PAINT_BYTE 0xA5 /* pattern written over fresh stacks */
+#define STACK_MIN_CLASS 1024 /* smallest recommended stack size class */
+#define MAX_STACK_ENTRY_POINTS 64 /* entry points the stack statistics keep apart */
+#define THREAD_POOL_SIZE (2 * MAX_THREAD_NUM) /* live threads plus zombies, the most stacks ever allocated */
+#define TASK_CLOCK_EVERY 8 /* tasks run between two looks at the clock */
+#define ADDRESS_BUCKET_BITS 6
+#define ADDRESS_BUCKETS (1 << ADDRESS_BUCKET_BITS) /* wait queues of uthread_wait_on */
+
+typedef void (*sig_handler) (int, siginfo_t *, void *);
 
 typedef unsigned long address_t;
 
@@ -26,62 +58,316 @@ using namespace std;
 
 enum STATE
 {
-    RUN, READY, BLOCKED, NOTEXISTS, SLEEPING
+    RUN, READY, BLOCKED, NOTEXISTS, SLEEPING,
+    WAITING // parked on a wait_queue by the library itself
 };
 
-class Thread
+/*
+ * FIFO of parked threads (uthread_wait_queue in uthreads.h, so mutexes and
+ * condition variables can embed one), doubly linked so a waiter can leave
+ * from the middle (when it is terminated) in O(1).
+ */
+typedef uthread_wait_queue wait_queue;
+typedef uthread_wait_node wait_node;
+
+/**
+ * a thread parked on a wait_queue. Nodes live on the waiting thread's own
+ * stack, which stays put for as long as it waits.
+ */
+struct uthread_wait_node
 {
- public:
-  int _id;
-  STATE _state;
-  char *_stack;
-  thread_entry_point _entry_point;
-  int _quantums;
-  int _remain_sleep_time; // in quantums
-  sigjmp_buf _env;
- public:
-  Thread ()
-  {
-    _id = 0;
-    _state = NOTEXISTS;
-    _stack = nullptr;
-    _entry_point = nullptr;
-    _quantums = 1;
-    _remain_sleep_time = 0;
-  }
-  Thread (int id, STATE state, char *stack, thread_entry_point entry_point,
-          int quantums, int remain_sleep_time)
-  {
-    _id = id;
-    _state = state;
-    _stack = stack;
-    _entry_point = entry_point;
-    _quantums = quantums;
-    _remain_sleep_time = remain_sleep_time;
-  }
-  ~Thread ()
-  {
-    delete _stack;
-  }
+  int tid;
+  wait_node *prev;
+  wait_node *next;
+  wait_queue *queue;
+};
+
+/**
+ * a thread parked in uthread_select: one node per case, all on its stack.
+ */
+struct select_wait
+{
+  const uthread_select_case *cases;
+  wait_node *nodes;
+  int amount;
+  int winner; // the case whose node was woken, -1 if none was
+};
+
+/*
+ * The thread control blocks live in one static arena indexed by tid. The
+ * fields the scheduler reads on every pass are kept as parallel arrays, so a
+ * walk over all threads touches a few contiguous cache lines; the bulky
+ * context (jump buffer, stack and register area pointers) sits apart in
+ * thread_contexts and is only touched when a thread is switched in or out.
+ */
+STATE thread_state[MAX_THREAD_NUM]; // NOTEXISTS marks a free slot
+int thread_quantums[MAX_THREAD_NUM];
+int thread_sleep[MAX_THREAD_NUM]; // total_tick to wake up at, 0 if awake
+int thread_deadline_slot[MAX_THREAD_NUM]; // index in deadlines, -1 if none
+long long thread_slack_ns[MAX_THREAD_NUM]; // -1 follows timer_slack_ns
+bool thread_block_pending[MAX_THREAD_NUM]; // blocked while WAITING
+int thread_base_priority[MAX_THREAD_NUM]; // as set by uthread_set_priority
+int thread_priority[MAX_THREAD_NUM]; // the base one, or more while inheriting
+
+struct thread_context
+{
+  sigjmp_buf env;
+  char *stack;
+  char *xstate; // FPU/vector registers saved while preempted
+  thread_entry_point entry_point;
+  thread_entry_point_arg entry_point_arg; // instead, if spawned with an arg
+  void *arg;
+  bool painted; // stack was filled with STACK_PAINT_BYTE at spawn
+  wait_node *wait; // set while WAITING
+  int wait_fd; // the fd a WAITING thread waits on, -1 if none
+  const volatile int *wait_address; // the uthread_wait_on address, if any
+  uthread_mutex_t *wait_mutex; // the mutex a WAITING thread waits to lock
+  uthread_mutex_t *held; // the mutexes it holds, linked by next_held
+  uthread_mutex_t *woken_by; // the mutex that woke it, until it tries again
+  uthread_rwlock_t *handed; // the rwlock handed to it, until it runs
+  select_wait *select; // set while WAITING in uthread_select
+  uthread_generator_t *generator; // whose body it runs now, nullptr if none
+  bool io_pending; // has a request on file_ring
+  int io_result; // of the last request, as the syscall's return or -errno
+  uthread_task_group_t *group; // it is a task of, nullptr if none
+  bool pool_worker; // runs the loop of a worker pool, which it alone ends
+};
+thread_context thread_contexts[MAX_THREAD_NUM];
+
+/**
+ * the memory a thread owns outside the arena, handed from a terminated thread
+ * to the reaper and from the reaper to the next spawn.
+ */
+struct thread_memory
+{
+  char *stack;
+  char *xstate;
+};
+
+/*
+ * Everything reachable from the timer works on these fixed-capacity
+ * structures and never calls malloc: the preempted thread may have been
+ * inside malloc itself. There is a ready queue per priority, each a ring
+ * buffer, oldest first; a thread is on one of them at most once, so
+ * MAX_THREAD_NUM entries always suffice.
+ */
+struct ready_queue
+{
+  int tids[MAX_THREAD_NUM];
+  int head;
+  int size;
 };
+ready_queue readies[UTHREAD_PRIORITY_LEVELS];
+unsigned int ready_levels = 0; // bit p is set while readies[p] is not empty
+int sleepings[MAX_THREAD_NUM];
+int sleepings_amount = 0;
+int next_sleeper_wake = 0; // no sleeper wakes before this total_tick
+long long idle_ns = 0; // idle wall time not yet counted as a quantum
 
-Thread *threads[MAX_THREAD_NUM];
-vector<int> readies;
-vector<int> sleepings;
+/*
+ * Timer slack: a sleep may end up to its thread's slack late. Wake times are
+ * rounded up to a multiple of the slack, so sleeps ending close together
+ * share one wake time and take one pass (and one tick) instead of one each.
+ */
+long long timer_slack_ns = 0;
+
+/*
+ * Threads sleeping until a point in time (CLOCK_MONOTONIC) sit in a binary
+ * min-heap by deadline. While it is not empty the tick is armed for the
+ * earlier of the end of the running quantum and the first deadline; a tick
+ * that fires for a deadline (early_tick) only wakes the sleepers and lets the
+ * running thread go on with the quantum_rest_us left of its quantum.
+ */
+struct deadline
+{
+  long long when_ns;
+  int tid; // a sleeping thread, or TIMER_ID of a callback timer
+};
+deadline deadlines[MAX_DEADLINES];
+int deadlines_amount = 0;
+bool early_tick = false; // the armed tick is for a deadline
+long quantum_rest_us = 0; // left of the quantum after the early tick
+int deadline_timer_fd = -1; // wakes idle() for the first deadline
+
+/*
+ * Callback timers have their deadlines in the same heap. A due timer is
+ * queued for the timer thread, a uthread of the library's own that runs the
+ * queued callbacks in one go whenever it gets to run, and waits on
+ * timer_waiters when the queue is empty. Disarming only clears fired: the
+ * timer thread skips the entry, so cancelling never searches the queue.
+ */
+struct callback_timer
+{
+  uthread_timer_callback callback; // nullptr marks a free timer
+  void *arg;
+  long long when_ns; // the next expiry, before timer slack
+  long long period_ns; // 0 for a one-shot timer
+  int slot; // index in deadlines, -1 if not armed
+  bool fired; // its callback is due
+  bool queued; // it is in fired_timers
+};
+callback_timer timers[MAX_TIMER_NUM];
+int fired_timers[MAX_TIMER_NUM]; // ring of the timers that came due
+int fired_head = 0;
+int fired_amount = 0;
+int timer_thread = -1;
+wait_queue timer_waiters = {nullptr, nullptr};
+
+// a piece of a uthread_parallel_for range, for the task that runs it
+struct range_task
+{
+  long begin;
+  long end;
+  long grain;
+  uthread_range_body body;
+  void *arg;
+};
+range_task range_tasks[MAX_THREAD_NUM];
+
+/*
+ * Tasks posted by uthread_post, run on the scheduler stack. The ring takes
+ * posts without blocking the tick: a poster claims a position by advancing
+ * post_tail, fills its slot and only then publishes it through the slot's
+ * turn, so a poster preempted halfway leaves a slot the scheduler does not
+ * run yet, and other posters go on past it. The scheduler alone takes them,
+ * on tick-driven passes too, which is why tasks may not allocate.
+ */
+struct posted_task
+{
+  thread_entry_point_arg task;
+  void *arg;
+  unsigned long turn; // 2 * lap while free for that lap, 2 * lap + 1 once filled
+};
+posted_task posted_tasks[MAX_POSTED_TASKS];
+unsigned long post_tail = 0; // the next position to claim
+unsigned long post_head = 0; // the next position to run
+int task_share = 50; // percent of the CPU for tasks while threads are READY
+long long task_credit_ns = 0; // task time earned by the threads' slices
+long long slice_start_ns = 0; // when the running thread was switched in
+
+// waiters of uthread_wait_on, by the hash of their address; they share a
+// bucket's queue with whatever else hashes there, so wakers check each one
+wait_queue address_buckets[ADDRESS_BUCKETS];
 int running_process_id = 0;
 int current_threads_amount = 0;
 int total_tick = 0;
 int quantum_len = 0;
 
+/*
+ * The tick: the timer chosen at init and the signal it raises. The CPU time
+ * clocks stand still while the process waits, so idle() stands in for them;
+ * the wall clocks keep ticking while the scheduler has the signal blocked,
+ * and the quantums they ended meanwhile are counted when it is taken.
+ */
+int tick_source = UTHREAD_CLOCK_VIRTUAL;
+int tick_signal = SIGVTALRM;
+timer_t tick_timer; // UTHREAD_CLOCK_POSIX only
+long long next_tick_ns = 0; // when the next quantum tick is due
+int tick_overrun = 0; // expirations merged into the last POSIX timer signal
+
+// scheduling decisions run on their own context, never on a thread's stack
+char *scheduler_stack = nullptr;
+char *signal_stack = nullptr;
+sigjmp_buf scheduler_env;
+STATE switch_state = READY; // the state the yielding thread asked for
+bool switch_on_tick = false; // the yield was forced by the timer
+
+// terminated threads wait here until the scheduler context frees them, so a
+// thread never releases the stack it is running on. Reaped threads are kept
+// (stack and all) for the next spawns instead of going back to the heap. A
+// stack is only allocated when the pool is empty, so every stack there is
+// fits in it, and the tick path never hands one back to the heap.
+thread_memory zombies[MAX_THREAD_NUM];
+int zombies_amount = 0;
+thread_memory thread_pool[THREAD_POOL_SIZE];
+int thread_pool_amount = 0;
+size_t xstate_size = FXSAVE_SIZE;
+
+/*
+ * Threads waiting for an fd are parked on that fd's queues; epoll watches
+ * exactly the fds that have waiters. Entries are allocated by the I/O calls
+ * and never move, so the scheduler can use them without allocating.
+ */
+struct fd_waiters
+{
+  wait_queue readers;
+  wait_queue writers;
+  uint32_t registered; // events epoll currently watches for
+};
+vector<fd_waiters *> fd_table;
+int epoll_fd = -1;
+int io_registered_amount = 0; // fds epoll currently watches
+epoll_event io_events[MAX_IO_EVENTS];
+
+/*
+ * File I/O goes through one io_uring owned by the scheduler. A thread puts its
+ * request in the submission ring and parks; the requests queued during a
+ * quantum are handed to the kernel by a single io_uring_enter when the quantum
+ * ends (or as soon as nothing else can run), and completions are taken off the
+ * completion ring at every switch. The ring fd sits in epoll so idle() wakes
+ * up for completions too.
+ */
+struct uring
+{
+  int fd; // -1 when io_uring is not available
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  io_uring_cqe *cqes;
+  unsigned queued; // in the submission ring, not yet seen by the kernel
+  unsigned in_flight; // submitted, not completed yet
+};
+uring file_ring = {-1, nullptr, nullptr, nullptr, nullptr,
+                   nullptr, nullptr, nullptr, nullptr, 0, 0};
+
+// shared with preempt_trampoline, hence C names and hidden visibility
+extern "C" {
+__attribute__((visibility("hidden"))) unsigned char preempt_use_xsave = 0;
+__attribute__((visibility("hidden"))) unsigned long preempt_tick_mask = 0;
+__attribute__((visibility("hidden"))) void preempt_trampoline ();
+__attribute__((visibility("hidden"))) void preempt_thread ();
+}
+
+char *new_xstate ()
+{
+  // xsave/xrstor need 64 byte alignment and a zeroed header
+  void *area = nullptr;
+  if (posix_memalign (&area, 64, xstate_size) != 0)
+  {
+    fprintf (stderr, "system error: could not allocate register area\n");
+    exit (1);
+  }
+  memset (area, 0, xstate_size);
+  return (char *) area;
+}
+
+/**
+ * Deepest stack use seen so far for one entry point, collected from painted
+ * threads when they terminate (or on demand).
+ */
+struct stack_usage
+{
+  thread_entry_point entry_point;
+  int max_used; // in bytes
+  int samples;
+};
+bool stack_painting = false;
+stack_usage stack_usages[MAX_STACK_ENTRY_POINTS]; // fixed, as terminate must not allocate
+int stack_usage_amount = 0;
+
 // ---------------------- jumping ------------------------
 
-sigset_t *block_sig ()
+sigset_t block_sig ()
 {
   sigset_t new_set, old_set;
   sigemptyset (&new_set);
-  sigaddset (&new_set, SIGVTALRM);
-  sigprocmask (SIG_SETMASK, &new_set, &old_set);
-  return &old_set;
+  sigaddset (&new_set, tick_signal);
+  sigprocmask (SIG_BLOCK, &new_set, &old_set);
+  return old_set;
 }
 
 void unblock_sig (sigset_t *old_set)
@@ -92,15 +378,20 @@ void unblock_sig (sigset_t *old_set)
 void jump_to_thread (int tid)
 {
   running_process_id = tid;
-  siglongjmp (threads[tid]->_env, 1);
+  siglongjmp (thread_contexts[tid].env, 1);
 }
-void yield (int jump_tid)
+
+/**
+ * saves the running thread and enters the scheduler context, which moves the
+ * thread to new_state and picks the next one. Must be called with the timer
+ * signal blocked; returns (still blocked) once the thread runs again.
+ */
+void yield (STATE new_state)
 {
-  int ret_val = sigsetjmp(threads[running_process_id]->_env, 1);
-  printf ("yield: ret_val=%d\n", ret_val);
-  if (ret_val == 0)
+  switch_state = new_state;
+  if (sigsetjmp(thread_contexts[running_process_id].env, 1) == 0)
   {
-    jump_to_thread (jump_tid);
+    siglongjmp (scheduler_env, 1);
   }
 }
 /* A translation is required when using an address of a variable.
@@ -118,386 +409,3687 @@ address_t translate_address (address_t addr)
 
 // ---------------------- inner ------------------------
 
-int is_exists (int tid)
+/**
+ * adds tid to the end of the READY queue of its priority.
+ */
+void ready_push (int tid)
 {
-  printf ("ASASAS enter function is_exists. running is %d. parameter: %d\n",
-          running_process_id, tid);
-  if (threads[tid]->_state == NOTEXISTS)
-  {
-    printf ("thread library error: thread does`nt exists\n");
-    printf ("thread library error: thread does`nt exists\n");
-    fflush (stderr);
-    return FAIL;
-  }
-  return SUCCESS;
+  ready_queue &level = readies[thread_priority[tid]];
+  level.tids[(level.head + level.size) % MAX_THREAD_NUM] = tid;
+  level.size++;
+  ready_levels |= 1u << thread_priority[tid];
 }
 
 /**
- * moves the current process to "current_new_state" and activates the first
- * thread in the ready queue.
- * @param current_new_state the state to which the current state will be
- * transfered
- * @return 0 on success, -1 on fail
+ * @return the highest priority with a READY thread, -1 if there is none
  */
-// todo: if ready = -1, return error
-int schedule (STATE current_new_state)
+int ready_top ()
 {
-  printf ("ASASAS entered function schedule. running is %d. parameter: %d\n",
-          running_process_id, current_new_state);
-  fflush (stdout);
+  return ready_levels == 0 ? FAIL : 31 - __builtin_clz (ready_levels);
+}
 
-  threads[running_process_id]->_state = current_new_state;
-  if (current_new_state == READY)
+/**
+ * removes the first thread of the highest priority READY queue.
+ * @return its id, -1 if every queue is empty
+ */
+int ready_pop ()
+{
+  int top = ready_top ();
+  if (top == FAIL)
   {
-    readies.insert (readies.begin (), running_process_id);
+    return FAIL;
   }
-  if (current_new_state != RUN)
+  ready_queue &level = readies[top];
+  int tid = level.tids[level.head];
+  level.head = (level.head + 1) % MAX_THREAD_NUM;
+  if (--level.size == 0)
   {
-    running_process_id = readies.back ();
-    readies.pop_back ();
-    if (running_process_id == FAIL)
-    {
-      printf ("thread library error: there are no threads to run\n");
-      fflush (stderr);
-      return FAIL;
-    }
-    threads[running_process_id]->_state = RUN;
-    jump_to_thread (running_process_id);
+    ready_levels &= ~(1u << top);
   }
-  fflush (stdout);
-  return SUCCESS;
-
+  return tid;
 }
 
-void manage_sleepers ()
+/**
+ * removes tid from wherever it is in the READY queue of its priority, keeping
+ * the order of the others.
+ */
+void ready_remove (int tid)
 {
-  printf ("ASASAS enter function manage_sleepers. running is %d. sleepers "
-          "amount: %zu\n",
-          running_process_id, sleepings.size ());
-  fflush (stdout);
-
-  for (auto sleepy: sleepings)
+  ready_queue &level = readies[thread_priority[tid]];
+  int kept = 0;
+  for (int i = 0; i < level.size; i++)
   {
-    if (--threads[sleepy]->_remain_sleep_time <= 0)
+    int other = level.tids[(level.head + i) % MAX_THREAD_NUM];
+    if (other != tid)
     {
-      if (threads[sleepy]->_state != BLOCKED)
-      {
-        threads[sleepy]->_state = READY;
-        readies.insert (readies.begin (), sleepy);
-      }
-      sleepings.erase (std::remove (sleepings.begin (), sleepings.end (), sleepy),
-                       sleepings.end ());
+      level.tids[(level.head + kept) % MAX_THREAD_NUM] = other;
+      kept++;
     }
   }
+  level.size = kept;
+  if (kept == 0)
+  {
+    ready_levels &= ~(1u << thread_priority[tid]);
+  }
 }
 
-void on_tick (int sig)
+/**
+ * gives tid the effective priority; a READY thread moves to the end of the
+ * queue of its new priority.
+ */
+void set_effective_priority (int tid, int priority)
 {
-  printf ("ASASAS enter function on_tick. running is %d\n",
-          running_process_id);
-  fflush (stdout);
-
-  if (sig == SIGVTALRM)
+  if (thread_priority[tid] == priority)
   {
-    printf ("ASASAS enter function on_tick. entered the if\n");
-    fflush (stdout);
-    threads[running_process_id]->_quantums++;
-    manage_sleepers ();
-    schedule (READY);
-    total_tick++;
+    return;
+  }
+  bool ready = thread_state[tid] == READY;
+  if (ready)
+  {
+    ready_remove (tid);
+  }
+  thread_priority[tid] = priority;
+  if (ready)
+  {
+    ready_push (tid);
   }
 }
 
-int set_clock (sig_handler timer_handler, int value, int interval)
+void sleeping_remove (int tid)
 {
-  struct sigaction sa = {nullptr};
-  struct itimerval timer;
+  sleepings_amount = (int) (std::remove (sleepings, sleepings + sleepings_amount,
+                                         tid) - sleepings);
+}
 
-  sa.sa_handler = &on_tick;
-  if (sigaction (SIGVTALRM, &sa, nullptr) < 0)
-  {
-    exit (1);
-    return -1;
-  }
+long long slack_of (int tid)
+{
+  return thread_slack_ns[tid] >= 0 ? thread_slack_ns[tid] : timer_slack_ns;
+}
 
-  timer.it_value.tv_sec = 0;
-  timer.it_value.tv_usec = value;
-  timer.it_interval.tv_sec = 0;
-  timer.it_interval.tv_usec = interval;
+long long round_up (long long value, long long grid)
+{
+  return grid > 1 ? (value + grid - 1) / grid * grid : value;
+}
 
-  if (setitimer (ITIMER_VIRTUAL, &timer, nullptr))
-  {
-    printf ("system error: setitimer error.\n");
-    fflush (stderr);
-    exit (1);
-    return -1;
-  }
+long long monotonic_ns ()
+{
+  timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
 
-  return SUCCESS;
+int &deadline_slot (int id)
+{
+  return id < MAX_THREAD_NUM ? thread_deadline_slot[id]
+                             : timers[id - MAX_THREAD_NUM].slot;
+}
+
+void deadline_place (int slot, const deadline &entry)
+{
+  deadlines[slot] = entry;
+  deadline_slot (entry.tid) = slot;
 }
 
 /**
- * finds the first free space in the threads array.
- * @return the id which was found on success, -1 otherwise.
+ * moves the entry at slot up or down the heap until it is in order again.
  */
-int look_for_id ()
+void deadline_sift (int slot)
 {
-  printf ("ASASAS enter function look_for_id. running is %d\n",
-          running_process_id);
-  fflush (stdout);
-
-  for (int i = 1; i < MAX_THREAD_NUM; i++)
+  deadline entry = deadlines[slot];
+  while (slot > 0 && deadlines[(slot - 1) / 2].when_ns > entry.when_ns)
   {
-    if (threads[i] == nullptr)
-    {  // sign for empty
-      return i;
+    deadline_place (slot, deadlines[(slot - 1) / 2]);
+    slot = (slot - 1) / 2;
+  }
+  while (2 * slot + 1 < deadlines_amount)
+  {
+    int child = 2 * slot + 1;
+    if (child + 1 < deadlines_amount
+        && deadlines[child + 1].when_ns < deadlines[child].when_ns)
+    {
+      child++;
     }
+    if (deadlines[child].when_ns >= entry.when_ns)
+    {
+      break;
+    }
+    deadline_place (slot, deadlines[child]);
+    slot = child;
   }
-  fflush (stdout);
-  return -1;
+  deadline_place (slot, entry);
 }
+
+void deadline_push (int tid, long long when_ns)
+{
+  deadlines[deadlines_amount] = {when_ns, tid};
+  deadlines_amount++;
+  deadline_sift (deadlines_amount - 1);
+}
+
+void deadline_remove (int tid)
+{
+  int slot = deadline_slot (tid);
+  deadline_slot (tid) = -1;
+  deadlines_amount--;
+  if (slot != deadlines_amount)
+  {
+    deadlines[slot] = deadlines[deadlines_amount];
+    deadline_sift (slot);
+  }
+}
+
+void timer_fire (int timer);
+void cancel_wait (int tid);
+void wake_thread (int tid);
+
 /**
- * Display all relevant data structures status for debugging
+ * moves every thread whose deadline has passed to READY (or leaves it BLOCKED
+ * if it was blocked while sleeping), and hands due timers to the timer thread.
  */
-void display_status ()
+void wake_deadlines ()
 {
-  printf ("---------------THREADS ARRAY------------------\n");
-  fflush (stdout);
-  for (int i = 0; i < MAX_THREAD_NUM; i++)
+  long long now = monotonic_ns ();
+  while (deadlines_amount > 0 && deadlines[0].when_ns <= now)
   {
-    printf ("thread id: %d, state: %u, \n", i, threads[i]->_state);
-    fflush (stdout);
+    int sleepy = deadlines[0].tid;
+    deadline_remove (sleepy);
+    if (sleepy >= MAX_THREAD_NUM)
+    {
+      timer_fire (sleepy - MAX_THREAD_NUM);
+    }
+    else if (thread_state[sleepy] == WAITING)
+    {
+      cancel_wait (sleepy); // a uthread_select timing out
+      wake_thread (sleepy);
+    }
+    else if (thread_state[sleepy] != BLOCKED)
+    {
+      thread_state[sleepy] = READY;
+      ready_push (sleepy);
+    }
   }
-  printf ("-----------------READY QUEUE----------------\n");
-  fflush (stdout);
-  cout << &readies << endl;
-  printf ("---------------SLEEPING LIST------------------\n");
-  fflush (stdout);
-  cout << &sleepings << endl;
 }
 
-void setup_thread (int tid, char *stack, thread_entry_point entry_point)
+long to_usecs (const timeval &time)
 {
-  sigset_t *old_set = block_sig ();
-
-  // initializes env[tid] to use the right stack, and to run from the function 'entry_point', when we'll use
-  // siglongjmp to jump into the thread.
-  address_t sp = (address_t) stack + STACK_SIZE - sizeof (address_t);
-  address_t pc = (address_t) entry_point;
-  sigsetjmp(threads[tid]->_env, 1);
-  (threads[tid]->_env->__jmpbuf)[JB_SP] = translate_address (sp);
-  (threads[tid]->_env->__jmpbuf)[JB_PC] = translate_address (pc);
-  sigemptyset (&threads[tid]->_env->__saved_mask);
+  return time.tv_sec * 1000000L + time.tv_usec;
 }
 
-// --------------------- API ---------------------------
-
-
-int uthread_init (int quantum_usecs)
+bool tick_on_wall_clock ()
 {
-  sigset_t *old_set = block_sig ();
-
-  set_clock (on_tick, quantum_usecs, quantum_usecs);
-  // init threads array
-  // Thread default_thread = Thread ();
-  // all is null
-//  for (auto &thread: threads)
-//  {
-//    thread = default_thread;
-//  } I think there might be a stack and entry_point
-  threads[0] = new Thread ();
-  threads[0]->_state = RUN;
-  unblock_sig (old_set);
-  return SUCCESS;
+  return tick_source == UTHREAD_CLOCK_REAL || tick_source == UTHREAD_CLOCK_POSIX;
 }
 
-
-int uthread_spawn (thread_entry_point entry_point)
+int tick_itimer ()
 {
-  sigset_t *old_set = block_sig ();
-
-  printf ("ASASAS enter function uthread_spawn. running is %d\n",
-          running_process_id);
-  // initialization & error checking
-  if (current_threads_amount > MAX_THREAD_NUM || entry_point == nullptr)
-  {
-    return FAIL;
-  }
-  int id = look_for_id ();
-  if (id == FAIL)
+  switch (tick_source)
   {
-    return FAIL;
+    case UTHREAD_CLOCK_PROF:
+      return ITIMER_PROF;
+    case UTHREAD_CLOCK_REAL:
+      return ITIMER_REAL;
+    default:
+      return ITIMER_VIRTUAL;
   }
-
-  char *stack = new char[sizeof (stack) * STACK_SIZE];
-
-  // create the new thread and pushes it to the ready queue
-  threads[id] = new Thread (id, READY, stack, entry_point, 1, 0);
-  setup_thread (id, stack, entry_point);
-  current_threads_amount++;
-  readies.insert (readies.begin (), id);
-  unblock_sig (old_set);
-  return id;
 }
 
-int uthread_terminate (int tid)
+/**
+ * reads the clock the tick counts down on. The virtual clock (user CPU time
+ * only) cannot be read, so it reads 0.
+ */
+long long tick_clock_ns ()
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_terminate. running is %d, parameter "
-          "is %d"
-          "\n",
-          running_process_id, tid);
-  if (is_exists (tid) == FAIL)
+  timespec now = {};
+  if (tick_source == UTHREAD_CLOCK_PROF)
   {
-    return FAIL;
+    clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &now);
   }
-
-  // delete from ready queue
-  if (threads[tid]->_state == READY)
+  else if (tick_source != UTHREAD_CLOCK_VIRTUAL)
   {
-    readies.erase (std::remove (readies.begin (), readies.end (), tid), readies.end ());
+    clock_gettime (CLOCK_MONOTONIC, &now);
   }
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
 
-  // delete from sleeping list
-  if (threads[tid]->_remain_sleep_time > 0)
+/**
+ * @return how long until the armed tick fires, in microseconds
+ */
+long tick_left_us ()
+{
+  if (tick_source == UTHREAD_CLOCK_POSIX)
   {
-    sleepings.erase (std::remove (sleepings.begin (), sleepings.end (), tid), sleepings.end ());
+    itimerspec timer;
+    timer_gettime (tick_timer, &timer);
+    return timer.it_value.tv_sec * 1000000L + timer.it_value.tv_nsec / 1000;
   }
+  itimerval timer;
+  getitimer (tick_itimer (), &timer);
+  return to_usecs (timer.it_value);
+}
 
-  //delete from threads array
-  delete threads[tid];
-  threads[tid] = nullptr;
-  current_threads_amount--;
-
-  if (tid == 0)
+/**
+ * arms the tick to fire in first_us, and then every interval_us (never again
+ * if it is 0).
+ */
+void tick_set (long first_us, long interval_us)
+{
+  if (tick_source == UTHREAD_CLOCK_POSIX)
   {
-    printf ("ASASASAS terminating the main thread\n");
-    fflush (stdout);
-    exit (0);
+    itimerspec timer = {};
+    timer.it_value = {first_us / 1000000, first_us % 1000000 * 1000};
+    timer.it_interval = {interval_us / 1000000, interval_us % 1000000 * 1000};
+    timer_settime (tick_timer, 0, &timer, nullptr);
+    return;
   }
-  unblock_sig (old_set);
-  return SUCCESS;
+  itimerval timer = {};
+  timer.it_value = {first_us / 1000000, first_us % 1000000};
+  timer.it_interval = {interval_us / 1000000, interval_us % 1000000};
+  setitimer (tick_itimer (), &timer, nullptr);
 }
 
-int uthread_block (int tid)
+/**
+ * how many quantums the tick that just came ended: one, plus those whose ticks
+ * the kernel merged into it while the signal was blocked or late. There is no
+ * telling for the virtual clock, which always counts one.
+ */
+int count_ticks ()
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_block. running is %d. parameter is "
-          "%d\n",
-          running_process_id, tid);
-  if (tid == 0)
+  if (tick_source == UTHREAD_CLOCK_POSIX)
   {
-    printf ("thread library error: cant block the main thread\n");
-    fflush (stderr);
-    return FAIL;
+    int ticks = 1 + tick_overrun;
+    tick_overrun = 0;
+    return ticks;
   }
-  if (is_exists (tid) == FAIL)
+  if (tick_source == UTHREAD_CLOCK_VIRTUAL)
   {
-    return FAIL;
+    return 1;
   }
-  if (tid == running_process_id)
+  long long now = tick_clock_ns ();
+  long long quantum_ns = quantum_len * 1000LL;
+  int ticks = 1;
+  if (now > next_tick_ns)
+  {
+    ticks += (int) ((now - next_tick_ns) / quantum_ns);
+  }
+  next_tick_ns += ticks * quantum_ns;
+  return ticks;
+}
+
+/**
+ * arms the tick for the earlier of the end of the running quantum and the
+ * first deadline. Does nothing while a tick is already pending: it re-arms
+ * once it is handled.
+ */
+void arm_tick ()
+{
+  sigset_t pending;
+  sigpending (&pending);
+  if (sigismember (&pending, tick_signal))
   {
-    return schedule (BLOCKED);
+    return;
   }
-  else if (threads[tid]->_state == READY)
+  long quantum_left = tick_left_us () + (early_tick ? quantum_rest_us : 0);
+  quantum_left = max (quantum_left, 1L);
+  long deadline_left = quantum_left;
+  if (deadlines_amount > 0)
   {
-    readies.erase (std::remove (readies.begin (), readies.end (), tid),
-                   readies.end ());
-    threads[tid]->_state = BLOCKED;
+    long long until = deadlines[0].when_ns - monotonic_ns ();
+    deadline_left = (long) max ((until + 999) / 1000, 1LL);
   }
-  unblock_sig (old_set);
-  return SUCCESS;
+  early_tick = deadline_left < quantum_left;
+  long first = early_tick ? deadline_left : quantum_left;
+  quantum_rest_us = quantum_left - first;
+  // an early tick fires once: arm_tick takes over again when it does
+  tick_set (first, early_tick ? 0 : quantum_len);
 }
 
-int uthread_resume (int tid)
+void wait_enqueue (wait_queue *queue, wait_node *node)
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_resume. running is %d, parameter is %d"
-          "\n",
-          running_process_id, tid);
-  if (is_exists (tid) == FAIL)
+  node->queue = queue;
+  node->next = nullptr;
+  node->prev = queue->tail;
+  if (queue->tail != nullptr)
   {
-    return FAIL;
+    queue->tail->next = node;
   }
-  if (threads[tid]->_state == BLOCKED)
+  else
   {
-    if (threads[tid]->_remain_sleep_time <= 0)
-    {
-      threads[tid]->_state = READY;
-      readies.insert (readies.begin (), tid);
+    queue->head = node;
+  }
+  queue->tail = node;
+}
+
+void wait_unlink (wait_node *node)
+{
+  wait_queue *queue = node->queue;
+  (node->prev != nullptr ? node->prev->next : queue->head) = node->next;
+  (node->next != nullptr ? node->next->prev : queue->tail) = node->prev;
+  node->queue = nullptr;
+}
+
+void fd_update_interest (int fd);
+
+/**
+ * takes the nodes of a thread parked in uthread_select off every queue but
+ * the one that woke it, if one did, which becomes its winner, and drops its
+ * timeout. Costs a step per case.
+ */
+void select_cancel (int tid)
+{
+  select_wait *select = thread_contexts[tid].select;
+  for (int i = 0; i < select->amount; i++)
+  {
+    if (select->nodes[i].queue == nullptr)
+    {
+      select->winner = i;
+      continue;
+    }
+    wait_unlink (&select->nodes[i]);
+    int kind = select->cases[i].kind;
+    if (kind == UTHREAD_SELECT_READ || kind == UTHREAD_SELECT_WRITE)
+    {
+      fd_update_interest (select->cases[i].fd);
+    }
+  }
+  if (thread_deadline_slot[tid] >= 0)
+  {
+    deadline_remove (tid);
+  }
+  thread_contexts[tid].select = nullptr;
+}
+
+/**
+ * ends the wait of tid: it goes to the end of the READY queue, or to BLOCKED
+ * if uthread_block was called on it while it waited.
+ */
+void wake_thread (int tid)
+{
+  if (thread_contexts[tid].select != nullptr)
+  {
+    select_cancel (tid);
+  }
+  thread_contexts[tid].wait = nullptr;
+  thread_contexts[tid].wait_fd = -1;
+  thread_contexts[tid].wait_address = nullptr;
+  thread_contexts[tid].wait_mutex = nullptr;
+  if (thread_block_pending[tid])
+  {
+    thread_block_pending[tid] = false;
+    thread_state[tid] = BLOCKED;
+    return;
+  }
+  thread_state[tid] = READY;
+  ready_push (tid);
+}
+
+/**
+ * wakes the longest waiting thread on queue.
+ * @return its id, -1 if nobody waits
+ */
+int wake_one (wait_queue *queue)
+{
+  wait_node *node = queue->head;
+  if (node == nullptr)
+  {
+    return FAIL;
+  }
+  wait_unlink (node);
+  wake_thread (node->tid);
+  return node->tid;
+}
+
+/**
+ * wakes every thread on queue, in the order they came: the queue is detached
+ * whole, so no node is unlinked one by one, and all of them are READY before
+ * the scheduler next runs.
+ */
+void wake_all (wait_queue *queue)
+{
+  wait_node *node = queue->head;
+  queue->head = nullptr;
+  queue->tail = nullptr;
+  while (node != nullptr)
+  {
+    wait_node *next = node->next; // node is on the stack of the thread woken
+    node->queue = nullptr;
+    wake_thread (node->tid);
+    node = next;
+  }
+}
+
+/**
+ * parks the running thread until someone wakes it through node's queue. Must
+ * be called with the tick blocked, after node was enqueued.
+ */
+void park (wait_node *node)
+{
+  thread_contexts[running_process_id].wait = node;
+  yield (WAITING);
+}
+
+/**
+ * parks the running thread at the end of queue.
+ */
+void wait_on (wait_queue *queue)
+{
+  wait_node node = {running_process_id, nullptr, nullptr, nullptr};
+  wait_enqueue (queue, &node);
+  park (&node);
+}
+
+wait_queue &address_bucket (const volatile int *address)
+{
+  // Fibonacci hashing: the high bits of the product mix every address bit
+  unsigned long long key = (uintptr_t) address * 0x9E3779B97F4A7C15ULL;
+  return address_buckets[key >> (64 - ADDRESS_BUCKET_BITS)];
+}
+
+void timer_fire (int timer)
+{
+  timers[timer].fired = true;
+  if (!timers[timer].queued)
+  {
+    timers[timer].queued = true;
+    fired_timers[(fired_head + fired_amount++) % MAX_TIMER_NUM] = timer;
+  }
+  wake_one (&timer_waiters);
+}
+
+void timer_arm (int timer)
+{
+  deadline_push (TIMER_ID (timer),
+                 round_up (timers[timer].when_ns, timer_slack_ns));
+  arm_tick ();
+}
+
+void timer_disarm (int timer)
+{
+  if (timers[timer].slot >= 0)
+  {
+    deadline_remove (TIMER_ID (timer));
+  }
+  timers[timer].fired = false;
+}
+
+/**
+ * the timer thread: runs the callbacks of the due timers in the order they
+ * came due, re-arming the periodic ones first, then waits for the next batch.
+ */
+void run_timers ()
+{
+  sigset_t old_set = block_sig ();
+  while (true)
+  {
+    if (fired_amount == 0)
+    {
+      wait_on (&timer_waiters);
+      continue;
+    }
+    int timer = fired_timers[fired_head];
+    fired_head = (fired_head + 1) % MAX_TIMER_NUM;
+    fired_amount--;
+    callback_timer &due = timers[timer];
+    due.queued = false;
+    if (!due.fired)
+    {
+      continue; // disarmed after it came due
+    }
+    due.fired = false;
+    uthread_timer_callback callback = due.callback;
+    void *arg = due.arg;
+    if (due.period_ns > 0)
+    {
+      // periods missed meanwhile are skipped, not made up in a burst
+      long long now = monotonic_ns ();
+      due.when_ns += due.period_ns;
+      if (due.when_ns <= now)
+      {
+        due.when_ns += ((now - due.when_ns) / due.period_ns + 1) * due.period_ns;
+      }
+      timer_arm (timer);
+    }
+    unblock_sig (&old_set);
+    callback (arg);
+    old_set = block_sig ();
+  }
+}
+
+/**
+ * the waiter on queue with the highest priority, the longest waiting of them
+ * on a tie; nullptr if nobody waits.
+ */
+wait_node *highest_waiter (wait_queue *queue)
+{
+  wait_node *highest = queue->head;
+  for (wait_node *node = queue->head; node != nullptr; node = node->next)
+  {
+    if (thread_priority[node->tid] > thread_priority[highest->tid])
+    {
+      highest = node;
+    }
+  }
+  return highest;
+}
+
+/**
+ * the priority tid inherits: its own, or that of the most urgent thread
+ * waiting for a mutex it holds, if higher.
+ */
+int inherited_priority (int tid)
+{
+  int priority = thread_base_priority[tid];
+  for (uthread_mutex_t *held = thread_contexts[tid].held; held != nullptr;
+       held = held->next_held)
+  {
+    wait_node *waiter = highest_waiter (&held->waiters);
+    if (waiter != nullptr)
+    {
+      priority = max (priority, thread_priority[waiter->tid]);
+    }
+  }
+  return priority;
+}
+
+/**
+ * lends priority to the holder of mutex and on along the chain of holders
+ * that wait for another mutex themselves. A cycle is a deadlock; the walk
+ * stops going around it once everyone on it has the priority.
+ */
+void boost_holders (uthread_mutex_t *mutex, int priority)
+{
+  while (mutex != nullptr && mutex->locked
+         && thread_priority[mutex->owner] < priority)
+  {
+    int owner = mutex->owner;
+    set_effective_priority (owner, priority);
+    mutex = thread_state[owner] == WAITING ? thread_contexts[owner].wait_mutex
+                                           : nullptr;
+  }
+}
+
+/**
+ * lowers the holders along the chain that starts at mutex to what they still
+ * inherit, once a thread waiting for mutex has stopped waiting.
+ */
+void unboost_holders (uthread_mutex_t *mutex)
+{
+  while (mutex != nullptr && mutex->locked)
+  {
+    int owner = mutex->owner;
+    int priority = inherited_priority (owner);
+    if (priority == thread_priority[owner])
+    {
+      break;
+    }
+    set_effective_priority (owner, priority);
+    mutex = thread_state[owner] == WAITING ? thread_contexts[owner].wait_mutex
+                                           : nullptr;
+  }
+}
+
+/**
+ * makes the running thread give way if a READY thread has a higher priority.
+ * Must be called with the tick blocked.
+ */
+void yield_to_higher ()
+{
+  if (ready_top () > thread_priority[running_process_id])
+  {
+    yield (READY);
+  }
+}
+
+/**
+ * records mutex as locked by the running thread.
+ */
+void mutex_take (uthread_mutex_t *mutex)
+{
+  mutex->locked = 1;
+  mutex->owner = running_process_id;
+  mutex->next_held = thread_contexts[running_process_id].held;
+  thread_contexts[running_process_id].held = mutex;
+}
+
+/**
+ * locks mutex for the running thread, parking while someone else holds it and
+ * lending the holder its priority meanwhile. Must be called with the tick
+ * blocked.
+ */
+void mutex_acquire (uthread_mutex_t *mutex)
+{
+  while (mutex->locked)
+  {
+    boost_holders (mutex, thread_priority[running_process_id]);
+    thread_contexts[running_process_id].wait_mutex = mutex;
+    wait_on (&mutex->waiters);
+    thread_contexts[running_process_id].woken_by = nullptr;
+  }
+  mutex_take (mutex);
+}
+
+/**
+ * wakes the most urgent thread waiting for mutex, if any, to try again.
+ */
+void mutex_wake_next (uthread_mutex_t *mutex)
+{
+  wait_node *waiter = highest_waiter (&mutex->waiters);
+  if (waiter != nullptr)
+  {
+    wait_unlink (waiter);
+    thread_contexts[waiter->tid].woken_by = mutex;
+    wake_thread (waiter->tid);
+  }
+}
+
+/**
+ * unlocks mutex, held by holder, for its most urgent waiter.
+ */
+void mutex_unhold (int holder, uthread_mutex_t *mutex)
+{
+  uthread_mutex_t **link = &thread_contexts[holder].held;
+  while (*link != mutex)
+  {
+    link = &(*link)->next_held;
+  }
+  *link = mutex->next_held;
+  mutex->next_held = nullptr;
+  mutex->locked = 0;
+  mutex_wake_next (mutex);
+}
+
+/**
+ * unlocks mutex, held by the running thread, for its most urgent waiter, and
+ * drops whatever priority the running thread inherited through it.
+ */
+void mutex_release (uthread_mutex_t *mutex)
+{
+  mutex_unhold (running_process_id, mutex);
+  thread_priority[running_process_id] = inherited_priority (running_process_id);
+}
+
+/**
+ * unlocks rwlock once for its holder, a writer or one of the readers, and
+ * hands it over: to the next writer, or else to every parked reader. The
+ * threads woken hold it already, and note that in handed until they run.
+ */
+void rwlock_release (uthread_rwlock_t *rwlock)
+{
+  if (rwlock->writer)
+  {
+    rwlock->writer = 0;
+  }
+  else
+  {
+    rwlock->readers--;
+  }
+  if (rwlock->readers == 0 && rwlock->write_waiters.head != nullptr)
+  {
+    rwlock->writer = 1;
+    thread_contexts[rwlock->write_waiters.head->tid].handed = rwlock;
+    wake_one (&rwlock->write_waiters);
+  }
+  else if (!rwlock->writer && rwlock->write_waiters.head == nullptr)
+  {
+    for (wait_node *node = rwlock->read_waiters.head; node != nullptr;
+         node = node->next)
+    {
+      rwlock->readers++;
+      thread_contexts[node->tid].handed = rwlock;
+    }
+    wake_all (&rwlock->read_waiters);
+  }
+}
+
+/**
+ * lets go of the locks of tid, which is ending: the mutexes it holds, and an
+ * rwlock handed to it that it never ran with, are unlocked as if it had
+ * unlocked them, and a wakeup it got from a mutex it did not take yet goes on
+ * to the next waiter.
+ */
+void locks_abandon (int tid)
+{
+  while (thread_contexts[tid].held != nullptr)
+  {
+    mutex_unhold (tid, thread_contexts[tid].held);
+  }
+  uthread_mutex_t *woken_by = thread_contexts[tid].woken_by;
+  if (woken_by != nullptr && !woken_by->locked)
+  {
+    mutex_wake_next (woken_by);
+  }
+  thread_contexts[tid].woken_by = nullptr;
+  if (thread_contexts[tid].handed != nullptr)
+  {
+    rwlock_release (thread_contexts[tid].handed);
+    thread_contexts[tid].handed = nullptr;
+  }
+}
+
+/**
+ * takes the oldest message off channel into *message, if there is one, and
+ * wakes a parked sender for the room left.
+ */
+bool channel_take (uthread_channel_t *channel, void **message)
+{
+  if (channel->count == 0)
+  {
+    return false;
+  }
+  *message = channel->slots[channel->head];
+  channel->head = (channel->head + 1) % channel->capacity;
+  channel->count--;
+  wake_one (&channel->senders);
+  return true;
+}
+
+/**
+ * puts message at the end of channel, if there is room, and wakes a parked
+ * receiver for it.
+ */
+bool channel_put (uthread_channel_t *channel, void *message)
+{
+  if (channel->count == channel->capacity)
+  {
+    return false;
+  }
+  channel->slots[(channel->head + channel->count) % channel->capacity] = message;
+  channel->count++;
+  wake_one (&channel->receivers);
+  return true;
+}
+
+/**
+ * makes epoll watch fd for exactly the directions it has waiters in. Safe
+ * to call from the scheduler context.
+ */
+void fd_update_interest (int fd)
+{
+  fd_waiters *waiters = fd_table[fd];
+  uint32_t events = 0;
+  if (waiters->readers.head != nullptr)
+  {
+    events |= EPOLLIN;
+  }
+  if (waiters->writers.head != nullptr)
+  {
+    events |= EPOLLOUT;
+  }
+  if (events == waiters->registered)
+  {
+    return;
+  }
+  epoll_event event = {};
+  event.events = events;
+  event.data.fd = fd;
+  if (events == 0)
+  {
+    epoll_ctl (epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    io_registered_amount--;
+  }
+  else if (waiters->registered == 0)
+  {
+    if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 && errno == EEXIST)
+    {
+      epoll_ctl (epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    }
+    io_registered_amount++;
+  }
+  else if (epoll_ctl (epoll_fd, EPOLL_CTL_MOD, fd, &event) < 0
+           && errno == ENOENT)
+  {
+    // the fd was closed and reopened since it was registered
+    epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+  waiters->registered = events;
+}
+
+/**
+ * gets fd ready for the I/O calls: it needs an fd_table entry. The fd is
+ * left as it is; io_attempt makes each call non-blocking on its own.
+ * @return the file status flags of fd, -1 if fd is not an open file
+ * descriptor
+ */
+int io_prepare (int fd)
+{
+  int flags = fd < 0 ? -1 : fcntl (fd, F_GETFL);
+  if (flags < 0)
+  {
+    return FAIL;
+  }
+  if ((size_t) fd >= fd_table.size ())
+  {
+    fd_table.resize (fd + 1, nullptr);
+  }
+  if (fd_table[fd] == nullptr)
+  {
+    fd_table[fd] = new fd_waiters ();
+  }
+  return flags;
+}
+
+/**
+ * makes one attempt at an I/O call on fd that says EAGAIN instead of
+ * stopping every thread in the process. O_NONBLOCK belongs to the open file
+ * description, which other processes may share (the shell's terminal behind
+ * stdout), so a blocking fd only has it for the length of the call.
+ * @param flags the file status flags of fd, from io_prepare
+ */
+template<typename Call>
+auto io_attempt (int fd, int flags, Call call) -> decltype (call ())
+{
+  if (flags & O_NONBLOCK)
+  {
+    return call ();
+  }
+  fcntl (fd, F_SETFL, flags | O_NONBLOCK);
+  auto result = call ();
+  int saved_errno = errno;
+  fcntl (fd, F_SETFL, flags);
+  errno = saved_errno;
+  return result;
+}
+
+/**
+ * parks the running thread until fd becomes readable (or writable).
+ */
+void io_wait (int fd, bool for_write)
+{
+  fd_waiters *waiters = fd_table[fd];
+  wait_node node = {running_process_id, nullptr, nullptr, nullptr};
+  wait_enqueue (for_write ? &waiters->writers : &waiters->readers, &node);
+  fd_update_interest (fd);
+  thread_contexts[running_process_id].wait_fd = fd;
+  park (&node);
+}
+
+/**
+ * the wait queue a uthread_select case parks on. Its fd, if any, went through
+ * io_prepare.
+ */
+wait_queue *select_queue (const uthread_select_case &what)
+{
+  switch (what.kind)
+  {
+    case UTHREAD_SELECT_RECEIVE:
+      return &what.channel->receivers;
+    case UTHREAD_SELECT_SEND:
+      return &what.channel->senders;
+    case UTHREAD_SELECT_READ:
+      return &fd_table[what.fd]->readers;
+    default:
+      return &fd_table[what.fd]->writers;
+  }
+}
+
+/**
+ * carries out the case if it is ready.
+ */
+bool select_try (uthread_select_case &what)
+{
+  switch (what.kind)
+  {
+    case UTHREAD_SELECT_RECEIVE:
+      return channel_take (what.channel, &what.message);
+    case UTHREAD_SELECT_SEND:
+      return channel_put (what.channel, what.message);
+    default:
+      pollfd ready = {what.fd, (short) (what.kind == UTHREAD_SELECT_READ
+                                        ? POLLIN : POLLOUT), 0};
+      return poll (&ready, 1, 0) > 0;
+  }
+}
+
+/**
+ * whether the cases can be waited on together: known kinds, initialized
+ * channels, open fds, and no wait queue twice.
+ */
+bool select_valid (uthread_select_case *cases, int amount)
+{
+  for (int i = 0; i < amount; i++)
+  {
+    uthread_select_case &what = cases[i];
+    if (what.kind == UTHREAD_SELECT_RECEIVE || what.kind == UTHREAD_SELECT_SEND)
+    {
+      if (what.channel == nullptr || what.channel->capacity <= 0)
+      {
+        return false;
+      }
+    }
+    else if ((what.kind != UTHREAD_SELECT_READ
+              && what.kind != UTHREAD_SELECT_WRITE)
+             || epoll_fd < 0 || io_prepare (what.fd) == FAIL)
+    {
+      return false;
+    }
+    for (int j = 0; j < i; j++)
+    {
+      if (select_queue (cases[j]) == select_queue (what))
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int is_exists (int tid)
+{
+  if (tid < 0 || tid >= MAX_THREAD_NUM || thread_state[tid] == NOTEXISTS)
+  {
+    printf ("thread library error: thread does`nt exists\n");
+    printf ("thread library error: thread does`nt exists\n");
+    fflush (stderr);
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+void manage_sleepers ();
+
+// ---------------------- I/O ------------------------
+
+/**
+ * sets up file_ring. If io_uring is missing or forbidden, file_ring.fd stays
+ * -1 and the file calls run synchronously.
+ */
+void uring_setup ()
+{
+  io_uring_params params = {};
+  int fd = (int) syscall (__NR_io_uring_setup, URING_ENTRIES, &params);
+  if (fd < 0)
+  {
+    return;
+  }
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+  size_t cq_size = params.cq_off.cqes
+                   + params.cq_entries * sizeof (io_uring_cqe);
+  size_t sqes_size = params.sq_entries * sizeof (io_uring_sqe);
+  void *sq = mmap (nullptr, sq_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  void *cq = mmap (nullptr, cq_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  void *sqes = mmap (nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED
+      || epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+  {
+    close (fd); // takes the mappings with it
+    return;
+  }
+  file_ring.sq_tail = (unsigned *) ((char *) sq + params.sq_off.tail);
+  file_ring.sq_mask = (unsigned *) ((char *) sq + params.sq_off.ring_mask);
+  file_ring.sq_array = (unsigned *) ((char *) sq + params.sq_off.array);
+  file_ring.sqes = (io_uring_sqe *) sqes;
+  file_ring.cq_head = (unsigned *) ((char *) cq + params.cq_off.head);
+  file_ring.cq_tail = (unsigned *) ((char *) cq + params.cq_off.tail);
+  file_ring.cq_mask = (unsigned *) ((char *) cq + params.cq_off.ring_mask);
+  file_ring.cqes = (io_uring_cqe *) ((char *) cq + params.cq_off.cqes);
+  file_ring.fd = fd;
+}
+
+/**
+ * queues request for the running thread and parks it until it completes.
+ * Must be called with the tick blocked.
+ * @return the request's result: what the syscall would return, or -errno
+ */
+int uring_run (const io_uring_sqe &request)
+{
+  unsigned tail = *file_ring.sq_tail;
+  unsigned index = tail & *file_ring.sq_mask;
+  file_ring.sqes[index] = request;
+  file_ring.sqes[index].user_data = (__u64) running_process_id;
+  file_ring.sq_array[index] = index;
+  __atomic_store_n (file_ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+  file_ring.queued++;
+  thread_contexts[running_process_id].io_pending = true;
+  yield (WAITING);
+  return thread_contexts[running_process_id].io_result;
+}
+
+/**
+ * turns the result of a file_ring request into a syscall style return value.
+ */
+ssize_t uring_return (int result)
+{
+  if (result < 0)
+  {
+    errno = -result;
+    return FAIL;
+  }
+  return result;
+}
+
+/**
+ * hands every queued request to the kernel with one io_uring_enter.
+ */
+void uring_submit ()
+{
+  if (file_ring.queued == 0)
+  {
+    return;
+  }
+  int submitted = (int) syscall (__NR_io_uring_enter, file_ring.fd,
+                                 file_ring.queued, 0, 0, nullptr, 0);
+  if (submitted > 0) // otherwise (EAGAIN) the next submit tries again
+  {
+    file_ring.queued -= submitted;
+    file_ring.in_flight += submitted;
+  }
+}
+
+/**
+ * takes all completions off file_ring and wakes the threads they belong to.
+ */
+void uring_reap ()
+{
+  unsigned head = *file_ring.cq_head;
+  unsigned tail = __atomic_load_n (file_ring.cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++)
+  {
+    io_uring_cqe *completion = &file_ring.cqes[head & *file_ring.cq_mask];
+    int tid = (int) completion->user_data;
+    thread_contexts[tid].io_result = completion->res;
+    thread_contexts[tid].io_pending = false;
+    file_ring.in_flight--;
+    if (thread_state[tid] == WAITING)
+    {
+      wake_thread (tid);
+    }
+  }
+  __atomic_store_n (file_ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * stops everything until the request of tid has completed: the kernel may
+ * write into its buffer until then, and that buffer may well be on the stack
+ * the next spawn gets.
+ */
+void uring_cancel (int tid)
+{
+  thread_state[tid] = BLOCKED; // so the completion does not make it READY
+  uring_submit ();
+  uring_reap ();
+  while (thread_contexts[tid].io_pending)
+  {
+    syscall (__NR_io_uring_enter, file_ring.fd, 0, 1, IORING_ENTER_GETEVENTS,
+             nullptr, 0);
+    uring_reap ();
+  }
+}
+
+/**
+ * parks the running thread until one of fds is ready or timeout ms passed.
+ * The fds go into a private epoll instance, together with a timerfd for the
+ * timeout, and the running thread waits for that instance like for any fd.
+ * @return as poll(2)
+ */
+int poll_wait (pollfd *fds, nfds_t nfds, int timeout)
+{
+  int waiter = epoll_create1 (EPOLL_CLOEXEC);
+  if (waiter < 0 || io_prepare (waiter) == FAIL)
+  {
+    return FAIL;
+  }
+  for (nfds_t i = 0; i < nfds; i++)
+  {
+    if (fds[i].fd < 0)
+    {
+      continue;
+    }
+    epoll_event event = {};
+    event.events = fds[i].events; // the POLL and EPOLL bits are the same
+    epoll_ctl (waiter, EPOLL_CTL_ADD, fds[i].fd, &event);
+  }
+  int timer = -1;
+  if (timeout > 0)
+  {
+    timer = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    itimerspec expiry = {};
+    expiry.it_value.tv_sec = timeout / 1000;
+    expiry.it_value.tv_nsec = (timeout % 1000) * 1000000L;
+    timerfd_settime (timer, 0, &expiry, nullptr);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    epoll_ctl (waiter, EPOLL_CTL_ADD, timer, &event);
+  }
+  int result = 0;
+  uint64_t expirations;
+  while (result == 0)
+  {
+    io_wait (waiter, false);
+    result = poll (fds, nfds, 0);
+    if (result == 0 && timer >= 0
+        && read (timer, &expirations, sizeof (expirations)) > 0)
+    {
+      break;
+    }
+  }
+  int saved_errno = errno;
+  if (timer >= 0)
+  {
+    close (timer);
+  }
+  close (waiter);
+  errno = saved_errno;
+  return result;
+}
+
+/**
+ * collects readiness from epoll and wakes the threads waiting for it.
+ * @param timeout as for epoll_wait, in milliseconds
+ * @return the number of fds that became ready
+ */
+int poll_io (int timeout)
+{
+  int ready = epoll_wait (epoll_fd, io_events, MAX_IO_EVENTS, timeout);
+  for (int i = 0; i < ready; i++)
+  {
+    int fd = io_events[i].data.fd;
+    if (fd == file_ring.fd)
+    {
+      continue; // completions are taken by uring_reap
+    }
+    if (fd == deadline_timer_fd)
+    {
+      uint64_t expirations;
+      read (fd, &expirations, sizeof (expirations)); // wake_deadlines follows
+      continue;
+    }
+    uint32_t events = io_events[i].events;
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    {
+      wake_all (&fd_table[fd]->readers);
+    }
+    if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+    {
+      wake_all (&fd_table[fd]->writers);
+    }
+    fd_update_interest (fd);
+  }
+  return max (ready, 0);
+}
+
+/**
+ * books a tick of the timer: the end of one quantum (or of several, when
+ * ticks were merged), or an early tick for a sleep deadline.
+ * @return true if it ended the running quantum
+ */
+bool account_tick ()
+{
+  if (early_tick)
+  {
+    wake_deadlines ();
+    arm_tick ();
+    return false;
+  }
+  total_tick += count_ticks ();
+  manage_sleepers ();
+  if (file_ring.queued > 0)
+  {
+    uring_submit (); // everything the threads asked for this quantum
+  }
+  if (deadlines_amount > 0)
+  {
+    arm_tick (); // the next deadline may come before the next quantum end
+  }
+  return true;
+}
+
+/**
+ * takes a tick that came while the scheduler had it blocked.
+ * @return true if there was one
+ */
+bool take_pending_tick ()
+{
+  sigset_t tick_set;
+  sigemptyset (&tick_set);
+  sigaddset (&tick_set, tick_signal);
+  siginfo_t info;
+  timespec no_wait = {0, 0};
+  if (sigtimedwait (&tick_set, &info, &no_wait) != tick_signal)
+  {
+    return false;
+  }
+  if (tick_source == UTHREAD_CLOCK_POSIX)
+  {
+    tick_overrun += info.si_overrun;
+  }
+  return true;
+}
+
+/**
+ * nothing is READY. Waits in epoll for the I/O waiters; if threads are
+ * sleeping it also waits for the next tick, or with a CPU time clock, which
+ * stands still while the process does not run, lets a quantum of wall time
+ * pass for them instead.
+ */
+void idle ()
+{
+  if (file_ring.fd >= 0)
+  {
+    uring_submit (); // no point in waiting for the end of the quantum
+  }
+  if (io_registered_amount == 0 && sleepings_amount == 0
+      && file_ring.in_flight == 0 && deadlines_amount == 0)
+  {
+    static const char msg[] = "system error: there are no threads to run\n";
+    write (STDERR_FILENO, msg, sizeof (msg) - 1);
+    _exit (1);
+  }
+  if (deadlines_amount > 0)
+  {
+    itimerspec expiry = {};
+    expiry.it_value.tv_sec = deadlines[0].when_ns / 1000000000LL;
+    expiry.it_value.tv_nsec = deadlines[0].when_ns % 1000000000LL;
+    timerfd_settime (deadline_timer_fd, TFD_TIMER_ABSTIME, &expiry, nullptr);
+  }
+  int timeout = -1;
+  int quantums = max (next_sleeper_wake - total_tick, 1);
+  if (sleepings_amount > 0)
+  {
+    // straight to the first wake up; a wall clock counts the ticks merged
+    long wait_us = (tick_on_wall_clock () ? tick_left_us () : quantum_len)
+                   + (long) (quantums - 1) * quantum_len;
+    timeout = (int) ((wait_us + 999) / 1000);
+  }
+  long long idle_start = monotonic_ns ();
+  poll_io (timeout);
+  if (tick_on_wall_clock ())
+  {
+    if (take_pending_tick ())
+    {
+      account_tick (); // nobody is running, whatever kind of tick it is
+    }
+  }
+  else if (sleepings_amount > 0)
+  {
+    // also when I/O or a deadline cut the wait short, or the sleepers starve
+    idle_ns += monotonic_ns () - idle_start;
+    long long quantum_ns = quantum_len * 1000LL;
+    if (idle_ns >= quantum_ns)
+    {
+      total_tick += (int) (idle_ns / quantum_ns);
+      idle_ns %= quantum_ns;
+      manage_sleepers ();
+    }
+  }
+  if (deadlines_amount > 0)
+  {
+    wake_deadlines ();
+  }
+  if (file_ring.in_flight > 0)
+  {
+    uring_reap ();
+  }
+}
+
+/**
+ * takes a WAITING thread off whatever it waits on.
+ */
+void cancel_wait (int tid)
+{
+  if (thread_contexts[tid].io_pending)
+  {
+    uring_cancel (tid);
+    return;
+  }
+  if (thread_contexts[tid].select != nullptr)
+  {
+    select_cancel (tid);
+    thread_contexts[tid].wait = nullptr;
+    return;
+  }
+  wait_unlink (thread_contexts[tid].wait);
+  if (thread_contexts[tid].wait_fd >= 0)
+  {
+    fd_update_interest (thread_contexts[tid].wait_fd);
+  }
+  thread_contexts[tid].wait = nullptr;
+  thread_contexts[tid].wait_fd = -1;
+  thread_contexts[tid].wait_address = nullptr;
+  thread_contexts[tid].wait_mutex = nullptr;
+}
+
+/**
+ * a unit of work submitted to an executor.
+ */
+struct work_item
+{
+  uthread_work_fn work;
+  void *arg;
+  uthread_future_t *future; // nullptr if nobody waits for the result
+};
+
+/**
+ * a fixed set of worker threads taking work from a bounded FIFO. Idle
+ * workers park on idle_workers, submitters on a full queue on submitters;
+ * shutting down waits for the workers and the parked submitters to leave.
+ */
+struct uthread_executor
+{
+  work_item *items;
+  int capacity;
+  int head; // the oldest item
+  int count;
+  int *workers; // their thread ids
+  int worker_amount;
+  int alive; // workers that have not ended yet
+  int parked_submitters; // submitters still to look at the executor again
+  bool shutting_down;
+  wait_queue idle_workers;
+  wait_queue submitters;
+  wait_queue shutdown_waiters;
+};
+
+/**
+ * a worker of an executor: runs its work items, oldest first, until the
+ * executor shuts down and the queue is empty.
+ */
+void executor_worker (void *arg)
+{
+  uthread_executor_t *executor = (uthread_executor_t *) arg;
+  sigset_t old_set = block_sig ();
+  while (true)
+  {
+    while (executor->count == 0 && !executor->shutting_down)
+    {
+      wait_on (&executor->idle_workers);
+    }
+    if (executor->count == 0)
+    {
+      break;
+    }
+    work_item item = executor->items[executor->head];
+    executor->head = (executor->head + 1) % executor->capacity;
+    executor->count--;
+    wake_one (&executor->submitters);
+    unblock_sig (&old_set);
+    void *result = item.work (item.arg);
+    old_set = block_sig ();
+    if (item.future != nullptr)
+    {
+      item.future->result = result;
+      item.future->done = 1;
+      wake_all (&item.future->waiters);
+    }
+  }
+  thread_contexts[running_process_id].pool_worker = false;
+  // the executor may be freed as soon as the last worker says it ended
+  if (--executor->alive == 0)
+  {
+    wake_all (&executor->shutdown_waiters);
+  }
+  unblock_sig (&old_set);
+}
+
+/**
+ * a fixed set of worker threads running the actors that have messages, in
+ * the order they got them, from an intrusive FIFO of actors. Idle workers
+ * park on idle_workers; uthread_actor_system_shutdown parks on
+ * quiet_waiters until the FIFO is empty and no behavior is running.
+ */
+struct uthread_actor_system
+{
+  uthread_actor_t *first_scheduled;
+  uthread_actor_t *last_scheduled;
+  int batch; // most messages of an actor per activation
+  int busy; // workers running a behavior
+  int *workers; // their thread ids
+  int worker_amount;
+  int alive; // workers that have not ended yet
+  bool shutting_down;
+  wait_queue idle_workers;
+  wait_queue quiet_waiters;
+  wait_queue shutdown_waiters;
+};
+
+/**
+ * puts actor at the back of the actors waiting for a worker.
+ * Signals must be blocked.
+ */
+void actor_schedule (uthread_actor_system_t *system, uthread_actor_t *actor)
+{
+  actor->next_scheduled = nullptr;
+  if (system->last_scheduled == nullptr)
+  {
+    system->first_scheduled = actor;
+  }
+  else
+  {
+    system->last_scheduled->next_scheduled = actor;
+  }
+  system->last_scheduled = actor;
+}
+
+/**
+ * a worker of an actor system: takes the actor waiting longest, hands up to
+ * a batch of its oldest messages to its behavior, and puts it back behind
+ * the others if it has more, until the system shuts down.
+ */
+void actor_worker (void *arg)
+{
+  uthread_actor_system_t *system = (uthread_actor_system_t *) arg;
+  sigset_t old_set = block_sig ();
+  while (true)
+  {
+    while (system->first_scheduled == nullptr && !system->shutting_down)
+    {
+      wait_on (&system->idle_workers);
+    }
+    uthread_actor_t *actor = system->first_scheduled;
+    if (actor == nullptr)
+    {
+      break;
+    }
+    system->first_scheduled = actor->next_scheduled;
+    if (system->first_scheduled == nullptr)
+    {
+      system->last_scheduled = nullptr;
+    }
+    uthread_message_t *batch = actor->first;
+    uthread_message_t *last = batch;
+    for (int taken = 1; taken < system->batch && last->next != nullptr;
+         taken++)
+    {
+      last = last->next;
+    }
+    actor->first = last->next;
+    if (actor->first == nullptr)
+    {
+      actor->last = nullptr;
+    }
+    last->next = nullptr;
+    system->busy++;
+    unblock_sig (&old_set);
+    actor->behavior (actor, batch);
+    old_set = block_sig ();
+    system->busy--;
+    if (actor->first != nullptr)
+    {
+      actor_schedule (system, actor);
+    }
+    else
+    {
+      actor->scheduled = 0;
+      if (system->busy == 0 && system->first_scheduled == nullptr)
+      {
+        wake_all (&system->quiet_waiters);
+      }
+    }
+  }
+  thread_contexts[running_process_id].pool_worker = false;
+  // the system may be freed as soon as the last worker says it ended
+  if (--system->alive == 0)
+  {
+    wake_all (&system->shutdown_waiters);
+  }
+  unblock_sig (&old_set);
+}
+
+/**
+ * whether the oldest posted task is filled in and can run.
+ */
+bool task_waiting ()
+{
+  const posted_task &slot = posted_tasks[post_head % MAX_POSTED_TASKS];
+  return __atomic_load_n (&slot.turn, __ATOMIC_ACQUIRE)
+         == post_head / MAX_POSTED_TASKS * 2 + 1;
+}
+
+/**
+ * runs posted tasks back to back, oldest first, until none is left or
+ * budget_ns has passed.
+ * @return the time they took
+ */
+long long run_tasks (long long budget_ns)
+{
+  long long start = monotonic_ns ();
+  long long now = start;
+  for (int ran = 1; task_waiting () && now - start < budget_ns; ran++)
+  {
+    posted_task &slot = posted_tasks[post_head % MAX_POSTED_TASKS];
+    thread_entry_point_arg task = slot.task;
+    void *arg = slot.arg;
+    __atomic_store_n (&slot.turn, (post_head / MAX_POSTED_TASKS + 1) * 2,
+                      __ATOMIC_RELEASE);
+    post_head++;
+    task (arg);
+    if (ran % TASK_CLOCK_EVERY == 0)
+    {
+      now = monotonic_ns ();
+    }
+  }
+  return monotonic_ns () - start;
+}
+
+/**
+ * runs tasks between two thread slices, for task_share percent of the time:
+ * the slice just ended earns them the matching share. What they overrun is
+ * paid back from the next slices; what they leave unused is not kept.
+ */
+void run_tasks_between ()
+{
+  if (task_share == 100)
+  {
+    run_tasks (LLONG_MAX);
+    return;
+  }
+  long long earned = (monotonic_ns () - slice_start_ns) * task_share
+                     / (100 - task_share);
+  task_credit_ns = min (task_credit_ns, 0LL) + earned;
+  task_credit_ns -= run_tasks (task_credit_ns);
+}
+
+/**
+ * nothing is READY but tasks are: runs them for a quantum, then takes what
+ * came meanwhile as idle would, without waiting for it.
+ */
+void run_tasks_idle ()
+{
+  run_tasks (quantum_len * 1000LL);
+  if (io_registered_amount > 0)
+  {
+    poll_io (0);
+  }
+  if (take_pending_tick ())
+  {
+    account_tick ();
+  }
+  if (deadlines_amount > 0)
+  {
+    wake_deadlines ();
+  }
+  if (file_ring.in_flight > 0)
+  {
+    uring_reap ();
+  }
+}
+
+/**
+ * moves the current process to "current_new_state" and activates the first
+ * thread in the ready queue. Runs on the scheduler context only and never
+ * returns.
+ * @param current_new_state the state to which the current state will be
+ * transfered
+ */
+void schedule (STATE current_new_state)
+{
+  if (current_new_state != NOTEXISTS) // a terminated thread has no slot left
+  {
+    thread_state[running_process_id] = current_new_state;
+  }
+  if (current_new_state == READY)
+  {
+    ready_push (running_process_id);
+  }
+  if (current_new_state != RUN)
+  {
+    if (io_registered_amount > 0)
+    {
+      poll_io (0);
+    }
+    if (file_ring.in_flight > 0)
+    {
+      uring_reap ();
+    }
+    if (task_share > 0 && task_waiting ())
+    {
+      run_tasks_between ();
+    }
+    int next = ready_pop ();
+    while (next == FAIL)
+    {
+      task_waiting () ? run_tasks_idle () : idle ();
+      next = ready_pop ();
+    }
+    running_process_id = next;
+    thread_state[running_process_id] = RUN;
+    slice_start_ns = monotonic_ns ();
+  }
+  jump_to_thread (running_process_id);
+}
+
+/**
+ * wakes the threads whose wake up tick has come. Ticks before the first of
+ * them cost nothing.
+ */
+void manage_sleepers ()
+{
+  if (total_tick < next_sleeper_wake)
+  {
+    return;
+  }
+  int still_sleeping = 0;
+  next_sleeper_wake = INT_MAX;
+  for (int i = 0; i < sleepings_amount; i++)
+  {
+    int sleepy = sleepings[i];
+    if (thread_sleep[sleepy] <= total_tick)
+    {
+      thread_sleep[sleepy] = 0;
+      if (thread_state[sleepy] != BLOCKED)
+      {
+        thread_state[sleepy] = READY;
+        ready_push (sleepy);
+      }
+    }
+    else
+    {
+      sleepings[still_sleeping++] = sleepy;
+      next_sleeper_wake = min (next_sleeper_wake, thread_sleep[sleepy]);
+    }
+  }
+  sleepings_amount = still_sleeping;
+}
+
+/**
+ * returns all zombies in one batch to the thread pool. Never call it on the
+ * stack of one of the zombies.
+ */
+void reap_zombies ()
+{
+  for (int i = 0; i < zombies_amount; i++)
+  {
+    thread_pool[thread_pool_amount++] = zombies[i];
+  }
+  zombies_amount = 0;
+}
+
+/**
+ * entry point of the scheduler context. Every yield lands right after the
+ * sigsetjmp, so this frame stays live for the lifetime of the library.
+ */
+void scheduler_main ()
+{
+  sigsetjmp(scheduler_env, 0);
+  if (zombies_amount > 0)
+  {
+    reap_zombies ();
+  }
+  if (switch_on_tick)
+  {
+    switch_on_tick = false;
+    if (account_tick ())
+    {
+      thread_quantums[running_process_id]++;
+    }
+    else
+    {
+      switch_state = RUN; // a deadline tick: the thread keeps its quantum
+    }
+  }
+  if (deadlines_amount > 0)
+  {
+    wake_deadlines ();
+  }
+  schedule (switch_state);
+}
+
+/*
+ * Reached from on_tick by a call injected into the preempted thread: on entry
+ * (%rsp) holds the thread's register area and 8(%rsp) the interrupted pc. It
+ * saves everything the C code may clobber, yields, and on the way back
+ * re-enables the tick only after the vector registers are restored, so a
+ * nested preemption cannot overwrite the area while it is still in use. The
+ * final ret also pops the red zone on_tick stepped over (RED_ZONE_SIZE).
+ */
+asm (R"(
+    .text
+    .p2align 4
+    .type preempt_trampoline, @function
+preempt_trampoline:
+    pushfq
+    pushq %rax
+    pushq %rcx
+    pushq %rdx
+    pushq %rsi
+    pushq %rdi
+    pushq %r8
+    pushq %r9
+    pushq %r10
+    pushq %r11
+    pushq %rbx
+    movq %rsp, %rbx
+    andq $-16, %rsp
+    movq 88(%rbx), %rcx
+    movl $-1, %eax
+    movl $-1, %edx
+    cmpb $0, preempt_use_xsave(%rip)
+    je 1f
+    xsave64 (%rcx)
+    jmp 2f
+1:  fxsave64 (%rcx)
+2:  call preempt_thread
+    movq 88(%rbx), %rcx
+    movl $-1, %eax
+    movl $-1, %edx
+    cmpb $0, preempt_use_xsave(%rip)
+    je 3f
+    xrstor64 (%rcx)
+    jmp 4f
+3:  fxrstor64 (%rcx)
+4:  movl $14, %eax
+    movl $1, %edi
+    leaq preempt_tick_mask(%rip), %rsi
+    xorl %edx, %edx
+    movl $8, %r10d
+    syscall
+    movq %rbx, %rsp
+    popq %rbx
+    popq %r11
+    popq %r10
+    popq %r9
+    popq %r8
+    popq %rdi
+    popq %rsi
+    popq %rdx
+    popq %rcx
+    popq %rax
+    popfq
+    leaq 8(%rsp), %rsp
+    ret $128
+    .size preempt_trampoline, .-preempt_trampoline
+)");
+
+/**
+ * called by preempt_trampoline on the preempted thread's stack, with the tick
+ * signal still blocked.
+ */
+void preempt_thread ()
+{
+  switch_on_tick = true;
+  yield (READY);
+}
+
+/**
+ * runs on the signal stack. Instead of scheduling from inside the handler it
+ * rewrites the interrupted context so that, once the handler returns, the
+ * thread calls preempt_trampoline as if it had done so itself. Only the few
+ * words pushed here land on the thread's stack.
+ */
+void on_tick (int sig, siginfo_t *info, void *context)
+{
+  if (sig != tick_signal)
+  {
+    return;
+  }
+  if (tick_source == UTHREAD_CLOCK_POSIX)
+  {
+    tick_overrun += info->si_overrun;
+  }
+  ucontext_t *uc = (ucontext_t *) context;
+  greg_t *regs = uc->uc_mcontext.gregs;
+  address_t sp = (address_t) regs[REG_RSP] - RED_ZONE_SIZE;
+  sp -= sizeof (address_t);
+  *(address_t *) sp = (address_t) regs[REG_RIP];
+  sp -= sizeof (address_t);
+  *(address_t *) sp = (address_t) thread_contexts[running_process_id].xstate;
+  regs[REG_RSP] = (greg_t) sp;
+  regs[REG_RIP] = (greg_t) &preempt_trampoline;
+  sigaddset (&uc->uc_sigmask, tick_signal);
+}
+
+/**
+ * finds out how large the register area saved on preemption has to be.
+ */
+void detect_xstate ()
+{
+  unsigned int eax, ebx, ecx, edx;
+  __cpuid (1, eax, ebx, ecx, edx);
+  if (ecx & bit_OSXSAVE)
+  {
+    __cpuid_count (0xD, 0, eax, ebx, ecx, edx);
+    xstate_size = max ((size_t) ebx, (size_t) FXSAVE_SIZE);
+    preempt_use_xsave = 1;
+  }
+  // the trampoline unblocks the tick with a raw rt_sigprocmask
+  preempt_tick_mask = 1UL << (tick_signal - 1);
+}
+
+int set_clock (sig_handler timer_handler, int value, int interval)
+{
+  struct sigaction sa = {};
+  stack_t ss = {};
+
+  signal_stack = new char[SIGNAL_STACK_SIZE];
+  ss.ss_sp = signal_stack;
+  ss.ss_size = SIGNAL_STACK_SIZE;
+  if (sigaltstack (&ss, nullptr) < 0)
+  {
+    printf ("system error: sigaltstack error.\n");
+    fflush (stderr);
+    exit (1);
+  }
+
+  sa.sa_sigaction = timer_handler;
+  sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+  if (sigaction (tick_signal, &sa, nullptr) < 0)
+  {
+    exit (1);
+    return -1;
+  }
+
+  if (tick_source == UTHREAD_CLOCK_POSIX)
+  {
+    // delivered to this very kernel thread, whatever else the process runs
+    sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = tick_signal;
+    event.sigev_notify_thread_id = (pid_t) syscall (SYS_gettid);
+    if (timer_create (CLOCK_MONOTONIC, &event, &tick_timer) < 0)
+    {
+      printf ("system error: timer_create error.\n");
+      fflush (stderr);
+      exit (1);
+      return -1;
+    }
+  }
+  next_tick_ns = tick_clock_ns () + value * 1000LL;
+  tick_set (value, interval);
+
+  return SUCCESS;
+}
+
+/**
+ * finds the first free space in the threads array.
+ * @return the id which was found on success, -1 otherwise.
+ */
+int look_for_id ()
+{
+  for (int i = 1; i < MAX_THREAD_NUM; i++)
+  {
+    if (thread_state[i] == NOTEXISTS)
+    {  // sign for empty
+      return i;
+    }
+  }
+  fflush (stdout);
+  return -1;
+}
+/**
+ * Display all relevant data structures status for debugging
+ */
+void display_status ()
+{
+  printf ("---------------THREADS ARRAY------------------\n");
+  fflush (stdout);
+  for (int i = 0; i < MAX_THREAD_NUM; i++)
+  {
+    if (thread_state[i] != NOTEXISTS)
+    {
+      printf ("thread id: %d, state: %u, \n", i, thread_state[i]);
+    }
+    fflush (stdout);
+  }
+  printf ("-----------------READY QUEUE----------------\n");
+  fflush (stdout);
+  for (int p = UTHREAD_PRIORITY_LEVELS - 1; p >= 0; p--)
+  {
+    for (int i = 0; i < readies[p].size; i++)
+    {
+      printf ("%d ", readies[p].tids[(readies[p].head + i) % MAX_THREAD_NUM]);
+    }
+  }
+  printf ("\n");
+  printf ("---------------SLEEPING LIST------------------\n");
+  fflush (stdout);
+  for (int i = 0; i < sleepings_amount; i++)
+  {
+    printf ("%d ", sleepings[i]);
+  }
+  printf ("\n");
+}
+
+/**
+ * scans a painted stack from its far end (stacks grow down) for the first
+ * byte that no longer holds the paint pattern.
+ * @return the number of bytes the thread has touched, -1 if the stack was
+ * not painted
+ */
+int stack_high_water (int tid)
+{
+  if (!thread_contexts[tid].painted)
+  {
+    return FAIL;
+  }
+  int untouched = 0;
+  while (untouched < STACK_SIZE
+         && (unsigned char) thread_contexts[tid].stack[untouched] == STACK_PAINT_BYTE)
+  {
+    untouched++;
+  }
+  return STACK_SIZE - untouched;
+}
+
+/**
+ * folds the high-water mark of a painted thread into the per entry point
+ * statistics.
+ */
+void record_stack_usage (int tid)
+{
+  int used = stack_high_water (tid);
+  if (used == FAIL)
+  {
+    return;
+  }
+  for (int i = 0; i < stack_usage_amount; i++)
+  {
+    if (stack_usages[i].entry_point == thread_contexts[tid].entry_point)
+    {
+      stack_usages[i].max_used = max (stack_usages[i].max_used, used);
+      stack_usages[i].samples++;
+      return;
+    }
+  }
+  if (stack_usage_amount < MAX_STACK_ENTRY_POINTS) // past that, new ones are dropped
+  {
+    stack_usages[stack_usage_amount++] = {thread_contexts[tid].entry_point,
+                                          used, 1};
+  }
+}
+
+/**
+ * rounds a measured high-water mark (plus a quarter for headroom) up to the
+ * next power of two, starting at STACK_MIN_CLASS.
+ */
+int stack_size_class (int used)
+{
+  int wanted = used + used / 4;
+  int size_class = STACK_MIN_CLASS;
+  while (size_class < wanted)
+  {
+    size_class *= 2;
+  }
+  return size_class;
+}
+
+/**
+ * initializes env to use the given stack, and to run from the function
+ * 'entry_point', when we'll use siglongjmp to jump into it.
+ */
+void setup_context (sigjmp_buf env, char *stack, int stack_size,
+                    thread_entry_point entry_point)
+{
+  address_t sp = (address_t) stack + stack_size - sizeof (address_t);
+  address_t pc = (address_t) entry_point;
+  sigsetjmp(env, 1);
+  (env->__jmpbuf)[JB_SP] = translate_address (sp);
+  (env->__jmpbuf)[JB_PC] = translate_address (pc);
+  sigemptyset (&env->__saved_mask);
+}
+
+/**
+ * first frame of every spawned thread. Threads are entered with the tick
+ * blocked, since siglongjmp restores the mask before it leaves the scheduler
+ * stack, and only unblock it once they are on their own stack.
+ */
+void thread_main ()
+{
+  thread_context &context = thread_contexts[running_process_id];
+  sigset_t tick_set;
+  sigemptyset (&tick_set);
+  sigaddset (&tick_set, tick_signal);
+  sigprocmask (SIG_UNBLOCK, &tick_set, nullptr);
+  if (context.entry_point_arg != nullptr)
+  {
+    context.entry_point_arg (context.arg);
+  }
+  else
+  {
+    context.entry_point ();
+  }
+  uthread_terminate (running_process_id);
+}
+
+void setup_thread (int tid, char *stack, thread_entry_point entry_point)
+{
+  (void) entry_point;
+  setup_context (thread_contexts[tid].env, stack, STACK_SIZE, thread_main);
+  sigaddset (&thread_contexts[tid].env->__saved_mask, tick_signal);
+}
+
+/**
+ * a generator: a context of its own, entered and left by plain jumps on the
+ * thread that resumes it. Neither the scheduler nor the tick take part; a
+ * preempted generator is just the running thread on another stack.
+ */
+struct uthread_generator
+{
+  sigjmp_buf env; // where the body goes on from
+  sigjmp_buf caller; // where uthread_generator_resume returns to
+  char *stack;
+  uthread_generator_body body;
+  void *arg;
+  void *value; // the last one yielded
+  bool running; // between a resume and the next yield
+  bool finished; // the body returned
+  uthread_generator_t *outer; // the generator it was resumed from, if any
+};
+
+/**
+ * saves the generator's body and returns to whoever resumed it.
+ */
+void generator_leave (uthread_generator_t *generator)
+{
+  thread_contexts[running_process_id].generator = generator->outer;
+  generator->running = false;
+  if (sigsetjmp (generator->env, 0) == 0)
+  {
+    siglongjmp (generator->caller, 1);
+  }
+}
+
+/**
+ * first frame of every generator.
+ */
+void generator_main ()
+{
+  uthread_generator_t *generator = thread_contexts[running_process_id].generator;
+  generator->body (generator->arg);
+  generator->finished = true;
+  generator_leave (generator); // never comes back
+}
+
+void setup_scheduler ()
+{
+  scheduler_stack = new char[SCHEDULER_STACK_SIZE];
+  setup_context (scheduler_env, scheduler_stack, SCHEDULER_STACK_SIZE,
+                 scheduler_main);
+  // entered with the tick blocked, and it has to stay so: no mask to restore
+  scheduler_env->__mask_was_saved = 0;
+}
+
+/**
+ * creates a READY thread (or recycles a reaped one) that runs entry_point, or
+ * entry_point_arg with arg when that is given. Call with the tick blocked.
+ * @return the new thread's id, -1 if there is no free id
+ */
+int spawn_thread (thread_entry_point entry_point,
+                  thread_entry_point_arg entry_point_arg, void *arg)
+{
+  int id = look_for_id ();
+  if (id == FAIL)
+  {
+    return FAIL;
+  }
+  thread_memory memory;
+  if (thread_pool_amount > 0)
+  {
+    memory = thread_pool[--thread_pool_amount];
+  }
+  else
+  {
+    memory.stack = new char[STACK_SIZE];
+    memory.xstate = new_xstate ();
+  }
+  thread_state[id] = READY;
+  thread_quantums[id] = 1;
+  thread_sleep[id] = 0;
+  thread_deadline_slot[id] = -1;
+  thread_slack_ns[id] = -1;
+  thread_block_pending[id] = false;
+  thread_base_priority[id] = 0;
+  thread_priority[id] = 0;
+  thread_contexts[id].wait = nullptr;
+  thread_contexts[id].wait_fd = -1;
+  thread_contexts[id].held = nullptr;
+  thread_contexts[id].woken_by = nullptr;
+  thread_contexts[id].handed = nullptr;
+  thread_contexts[id].select = nullptr;
+  thread_contexts[id].generator = nullptr;
+  thread_contexts[id].io_pending = false;
+  thread_contexts[id].group = nullptr;
+  thread_contexts[id].pool_worker = false;
+  thread_contexts[id].stack = memory.stack;
+  thread_contexts[id].xstate = memory.xstate;
+  thread_contexts[id].entry_point = entry_point;
+  thread_contexts[id].entry_point_arg = entry_point_arg;
+  thread_contexts[id].arg = arg;
+  char *stack = memory.stack;
+  if (stack_painting)
+  {
+    memset (stack, STACK_PAINT_BYTE, STACK_SIZE);
+  }
+  thread_contexts[id].painted = stack_painting;
+  setup_thread (id, stack, entry_point);
+  current_threads_amount++;
+  ready_push (id);
+  return id;
+}
+
+/**
+ * spawns task(arg) as a thread that belongs to group. Call with the tick
+ * blocked.
+ * @return the task's id, -1 if there is no free id
+ */
+int group_spawn (uthread_task_group_t *group, thread_entry_point_arg task,
+                 void *arg)
+{
+  int id = spawn_thread ((thread_entry_point) task, task, arg);
+  if (id != FAIL)
+  {
+    thread_contexts[id].group = group;
+    group->pending++;
+  }
+  return id;
+}
+
+/**
+ * runs a uthread_parallel_for range: hands the right half to a new task while
+ * the range is longer than the grain and keeps the left one, so the splits
+ * do not nest on any thread's stack. The task's range is copied into
+ * range_tasks at its id, which stays its own until it ends. When no id is
+ * left the rest runs here, a grain at a time.
+ */
+void run_range (void *task)
+{
+  range_task range = *(range_task *) task;
+  uthread_task_group_t group = UTHREAD_TASK_GROUP_INITIALIZER;
+  while (range.end - range.begin > range.grain)
+  {
+    long middle = range.begin + (range.end - range.begin) / 2;
+    sigset_t old_set = block_sig ();
+    int id = group_spawn (&group, run_range, nullptr);
+    if (id != FAIL)
+    {
+      range_tasks[id] = {middle, range.end, range.grain, range.body,
+                         range.arg};
+      thread_contexts[id].arg = &range_tasks[id];
+      range.end = middle;
+    }
+    unblock_sig (&old_set);
+    if (id == FAIL)
+    {
+      break;
+    }
+  }
+  for (long begin = range.begin; begin < range.end; begin += range.grain)
+  {
+    range.body (begin, min (begin + range.grain, range.end), range.arg);
+  }
+  uthread_task_group_wait (&group);
+}
+
+// --------------------- API ---------------------------
+
+
+int uthread_init (int quantum_usecs)
+{
+  return uthread_init_clock (quantum_usecs, UTHREAD_CLOCK_VIRTUAL);
+}
+
+int uthread_init_clock (int quantum_usecs, int clock_source)
+{
+  if (quantum_usecs <= 0)
+  {
+    fprintf (stderr, "thread library error: quantum_usecs should be positive\n");
+    return FAIL;
+  }
+  switch (clock_source)
+  {
+    case UTHREAD_CLOCK_VIRTUAL:
+      tick_signal = SIGVTALRM;
+      break;
+    case UTHREAD_CLOCK_PROF:
+      tick_signal = SIGPROF;
+      break;
+    case UTHREAD_CLOCK_REAL:
+      tick_signal = SIGALRM;
+      break;
+    case UTHREAD_CLOCK_POSIX:
+      tick_signal = SIGRTMIN;
+      break;
+    default:
+      fprintf (stderr, "thread library error: unknown clock source\n");
+      return FAIL;
+  }
+  tick_source = clock_source;
+  sigset_t old_set = block_sig ();
+  quantum_len = quantum_usecs;
+  detect_xstate ();
+  setup_scheduler ();
+  set_clock (on_tick, quantum_usecs, quantum_usecs);
+  slice_start_ns = monotonic_ns (); // the main thread runs from here
+  // init threads array: every slot but the main thread's is free
+  fill (thread_state, thread_state + MAX_THREAD_NUM, NOTEXISTS);
+  fill (thread_deadline_slot, thread_deadline_slot + MAX_THREAD_NUM, -1);
+  fill (thread_slack_ns, thread_slack_ns + MAX_THREAD_NUM, -1LL);
+  thread_state[0] = RUN;
+  thread_quantums[0] = 1;
+  thread_contexts[0].xstate = new_xstate ();
+  thread_contexts[0].wait_fd = -1;
+  epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+  if (epoll_fd < 0)
+  {
+    printf ("system error: epoll_create1 error.\n");
+    fflush (stderr);
+    exit (1);
+  }
+  deadline_timer_fd = timerfd_create (CLOCK_MONOTONIC,
+                                     TFD_NONBLOCK | TFD_CLOEXEC);
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = deadline_timer_fd;
+  epoll_ctl (epoll_fd, EPOLL_CTL_ADD, deadline_timer_fd, &event);
+  uring_setup ();
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+
+int uthread_spawn (thread_entry_point entry_point)
+{
+  sigset_t old_set = block_sig ();
+
+  // initialization & error checking
+  if (current_threads_amount > MAX_THREAD_NUM || entry_point == nullptr)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int id = spawn_thread (entry_point, nullptr, nullptr);
+  unblock_sig (&old_set);
+  return id;
+}
+
+int uthread_spawn_arg (thread_entry_point_arg entry_point, void *arg)
+{
+  sigset_t old_set = block_sig ();
+  if (current_threads_amount > MAX_THREAD_NUM || entry_point == nullptr)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  // the stack usage statistics group threads by this function as well
+  int id = spawn_thread ((thread_entry_point) entry_point, entry_point, arg);
+  unblock_sig (&old_set);
+  return id;
+}
+
+int uthread_terminate (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (is_exists (tid) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (thread_contexts[tid].pool_worker)
+  {
+    // its pool would wait for it forever, and its work would never finish
+    fprintf (stderr, "thread library error: a pool worker ends with its "
+                     "pool\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+
+  // delete from ready queue
+  if (thread_state[tid] == READY)
+  {
+    ready_remove (tid);
+  }
+
+  // delete from sleeping list
+  if (thread_sleep[tid] > 0)
+  {
+    sleeping_remove (tid);
+  }
+  if (thread_deadline_slot[tid] >= 0)
+  {
+    deadline_remove (tid);
+  }
+
+  // delete from whatever it waits on, and take back the priority it lent
+  if (thread_state[tid] == WAITING)
+  {
+    uthread_mutex_t *wanted = thread_contexts[tid].wait_mutex;
+    cancel_wait (tid);
+    unboost_holders (wanted);
+  }
+  locks_abandon (tid);
+
+  record_stack_usage (tid);
+  if (tid == timer_thread)
+  {
+    timer_thread = -1; // the next timer created starts another one
+  }
+  uthread_task_group_t *group = thread_contexts[tid].group;
+  if (group != nullptr && --group->pending == 0)
+  {
+    wake_all (&group->waiters);
+  }
+
+  // remove from threads array; the memory goes to the reaper, since a thread
+  // terminating itself is still running on its stack
+  if (zombies_amount == MAX_THREAD_NUM)
+  {
+    reap_zombies (); // only other threads' zombies are ever left waiting
+  }
+  thread_state[tid] = NOTEXISTS;
+  zombies[zombies_amount++] = {thread_contexts[tid].stack,
+                               thread_contexts[tid].xstate};
+  current_threads_amount--;
+
+  if (tid == 0)
+  {
+    exit (0);
+  }
+  if (tid == running_process_id)
+  {
+    // nothing to save: go straight to the scheduler, which reaps us
+    switch_state = NOTEXISTS;
+    siglongjmp (scheduler_env, 1);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_block (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (tid == 0)
+  {
+    printf ("thread library error: cant block the main thread\n");
+    fflush (stderr);
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (is_exists (tid) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (tid == running_process_id)
+  {
+    yield (BLOCKED);
+  }
+  else if (thread_state[tid] == READY)
+  {
+    ready_remove (tid);
+    thread_state[tid] = BLOCKED;
+  }
+  else if (thread_state[tid] == WAITING)
+  {
+    thread_block_pending[tid] = true; // takes effect once the wait is over
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_resume (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (is_exists (tid) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (thread_state[tid] == BLOCKED)
+  {
+    if (thread_sleep[tid] <= 0 && thread_deadline_slot[tid] < 0)
+    {
+      thread_state[tid] = READY;
+      ready_push (tid);
+    }
+    else
+    {
+      thread_state[tid] = RUN; // when it will wake up it will return to
+      // ready
+    }
+  }
+  else if (thread_state[tid] == WAITING)
+  {
+    thread_block_pending[tid] = false;
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_sleep (int num_quantums)
+{
+  sigset_t old_set = block_sig ();
+
+  if (running_process_id == 0)
+  {
+    printf ("thread library error: cant put to sleep the main thread\n");
+    fflush (stderr);
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (num_quantums <= 0)
+  { // todo: needs to be positive or not-negative?
+    printf ("thread library error: num_quantums should be positive\n");
+    fflush (stderr);
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  // todo: make sure it should be +1 (since the current doesnt count)
+  long long slack = slack_of (running_process_id) / (quantum_len * 1000LL);
+  int wake = (int) round_up (total_tick + num_quantums + 1, slack);
+  thread_sleep[running_process_id] = wake;
+  if (sleepings_amount == 0 || wake < next_sleeper_wake)
+  {
+    next_sleeper_wake = wake;
+  }
+  sleepings[sleepings_amount++] = running_process_id;
+  yield (SLEEPING);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_sleep_us (unsigned long usecs)
+{
+  return uthread_sleep_until (monotonic_ns () + (long long) usecs * 1000);
+}
+
+int uthread_sleep_until (long long abs_ns)
+{
+  sigset_t old_set = block_sig ();
+  if (quantum_len == 0)
+  {
+    fprintf (stderr, "thread library error: the library is not initialized\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (abs_ns > monotonic_ns ())
+  {
+    deadline_push (running_process_id,
+                   round_up (abs_ns, slack_of (running_process_id)));
+    arm_tick ();
+    yield (SLEEPING);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_set_timer_slack (long usecs)
+{
+  sigset_t old_set = block_sig ();
+  if (usecs < 0)
+  {
+    fprintf (stderr, "thread library error: the slack cannot be negative\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  timer_slack_ns = usecs * 1000LL;
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_set_thread_slack (int tid, long usecs)
+{
+  sigset_t old_set = block_sig ();
+  if (tid < 0 || tid >= MAX_THREAD_NUM || thread_state[tid] == NOTEXISTS)
+  {
+    fprintf (stderr, "thread library error: thread does`nt exists\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  thread_slack_ns[tid] = usecs < 0 ? -1 : usecs * 1000LL;
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_set_priority (int tid, int priority)
+{
+  sigset_t old_set = block_sig ();
+  if (tid < 0 || tid >= MAX_THREAD_NUM || thread_state[tid] == NOTEXISTS)
+  {
+    fprintf (stderr, "thread library error: thread does`nt exists\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (priority < 0 || priority >= UTHREAD_PRIORITY_LEVELS)
+  {
+    fprintf (stderr, "thread library error: no such priority\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  thread_base_priority[tid] = priority;
+  set_effective_priority (tid, inherited_priority (tid));
+  if (thread_state[tid] == WAITING)
+  {
+    boost_holders (thread_contexts[tid].wait_mutex, thread_priority[tid]);
+  }
+  yield_to_higher ();
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_get_priority (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (tid < 0 || tid >= MAX_THREAD_NUM || thread_state[tid] == NOTEXISTS)
+  {
+    fprintf (stderr, "thread library error: thread does`nt exists\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int priority = thread_priority[tid];
+  unblock_sig (&old_set);
+  return priority;
+}
+
+int uthread_task_group_spawn (uthread_task_group_t *group,
+                              thread_entry_point_arg task, void *arg)
+{
+  sigset_t old_set = block_sig ();
+  if (group == nullptr || task == nullptr)
+  {
+    fprintf (stderr, "thread library error: no group or no task\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int id = group_spawn (group, task, arg);
+  unblock_sig (&old_set);
+  if (id == FAIL)
+  {
+    // no thread id left: the caller runs it, which also bounds the fan-out
+    task (arg);
+    return UTHREAD_RAN_INLINE;
+  }
+  return id;
+}
+
+int uthread_task_group_wait (uthread_task_group_t *group)
+{
+  sigset_t old_set = block_sig ();
+  if (group == nullptr)
+  {
+    fprintf (stderr, "thread library error: no group\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  while (group->pending > 0)
+  {
+    wait_on (&group->waiters);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_parallel_for (long begin, long end, long grain,
+                          uthread_range_body body, void *arg)
+{
+  if (grain <= 0 || body == nullptr)
+  {
+    fprintf (stderr, "thread library error: grain should be positive and "
+                     "body given\n");
+    return FAIL;
+  }
+  if (begin < end)
+  {
+    range_task whole = {begin, end, grain, body, arg};
+    run_range (&whole);
+  }
+  return SUCCESS;
+}
+
+/**
+ * checks that timer is a timer handle in use.
+ */
+int timer_exists (int timer)
+{
+  if (timer < 0 || timer >= MAX_TIMER_NUM || timers[timer].callback == nullptr)
+  {
+    fprintf (stderr, "thread library error: no such timer\n");
+    return FAIL;
+  }
+  return SUCCESS;
+}
+
+int uthread_timer_create (uthread_timer_callback callback, void *arg,
+                          unsigned long first_usecs, unsigned long period_usecs)
+{
+  sigset_t old_set = block_sig ();
+  if (quantum_len == 0 || callback == nullptr)
+  {
+    fprintf (stderr, "thread library error: the library is not initialized "
+                     "or the callback is missing\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int timer = 0;
+  while (timer < MAX_TIMER_NUM && timers[timer].callback != nullptr)
+  {
+    timer++;
+  }
+  if (timer == MAX_TIMER_NUM)
+  {
+    fprintf (stderr, "thread library error: too many timers\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (timer_thread < 0)
+  {
+    timer_thread = spawn_thread (run_timers, nullptr, nullptr);
+    if (timer_thread == FAIL)
+    {
+      fprintf (stderr, "thread library error: no thread left for the timers\n");
+      unblock_sig (&old_set);
+      return FAIL;
+    }
+  }
+  callback_timer &created = timers[timer];
+  created.callback = callback;
+  created.arg = arg;
+  created.when_ns = monotonic_ns () + (long long) first_usecs * 1000;
+  created.period_ns = (long long) period_usecs * 1000;
+  created.slot = -1;
+  created.fired = false; // queued stays: the timer thread may still hold it
+  timer_arm (timer);
+  unblock_sig (&old_set);
+  return timer;
+}
+
+int uthread_timer_reschedule (int timer, unsigned long first_usecs,
+                              unsigned long period_usecs)
+{
+  sigset_t old_set = block_sig ();
+  if (timer_exists (timer) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  timer_disarm (timer);
+  timers[timer].when_ns = monotonic_ns () + (long long) first_usecs * 1000;
+  timers[timer].period_ns = (long long) period_usecs * 1000;
+  timer_arm (timer);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_timer_cancel (int timer)
+{
+  sigset_t old_set = block_sig ();
+  if (timer_exists (timer) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  timer_disarm (timer);
+  timers[timer].callback = nullptr;
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_get_tid ()
+{
+  sigset_t old_set = block_sig ();
+  unblock_sig (&old_set);
+  return running_process_id;
+}
+
+int uthread_get_total_quantums ()
+{
+  sigset_t old_set = block_sig ();
+  // todo: what does it means "including the current"?
+  unblock_sig (&old_set);
+  return total_tick;
+}
+
+int uthread_get_quantums (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (is_exists (tid) == FAIL)
+  {
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int quantums = thread_quantums[tid];
+  unblock_sig (&old_set);
+  return quantums;
+}
+
+int uthread_stack_painting (int enable)
+{
+  sigset_t old_set = block_sig ();
+  stack_painting = enable != 0;
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_get_stack_usage (int tid)
+{
+  sigset_t old_set = block_sig ();
+  if (tid < 0 || tid >= MAX_THREAD_NUM || thread_state[tid] == NOTEXISTS)
+  {
+    fprintf (stderr, "thread library error: thread does`nt exists\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  int used = stack_high_water (tid);
+  if (used == FAIL)
+  {
+    fprintf (stderr, "thread library error: stack was not painted\n");
+  }
+  unblock_sig (&old_set);
+  return used;
+}
+
+void uthread_stack_report ()
+{
+  sigset_t old_set = block_sig ();
+  // live threads count as a sample too, without being recorded twice later
+  vector<stack_usage> report (stack_usages, stack_usages + stack_usage_amount);
+  for (int i = 1; i < MAX_THREAD_NUM; i++)
+  {
+    if (thread_state[i] == NOTEXISTS || !thread_contexts[i].painted)
+    {
+      continue;
+    }
+    int used = stack_high_water (i);
+    auto usage = find_if (report.begin (), report.end (),
+                          [i] (const stack_usage &u)
+                          { return u.entry_point == thread_contexts[i].entry_point; });
+    if (usage == report.end ())
+    {
+      report.push_back ({thread_contexts[i].entry_point, used, 1});
+    }
+    else
+    {
+      usage->max_used = max (usage->max_used, used);
+      usage->samples++;
+    }
+  }
+
+  int worst = 0;
+  printf ("---------------STACK USAGE------------------\n");
+  for (auto &usage: report)
+  {
+    printf ("entry point: %p, samples: %d, max used: %d, class: %d\n",
+            (void *) usage.entry_point, usage.samples, usage.max_used,
+            stack_size_class (usage.max_used));
+    worst = max (worst, usage.max_used);
+  }
+  printf ("recommended STACK_SIZE: %d (currently %d)\n",
+          stack_size_class (worst), STACK_SIZE);
+  fflush (stdout);
+  unblock_sig (&old_set);
+}
+
+ssize_t uthread_read (int fd, void *buf, size_t count)
+{
+  sigset_t old_set = block_sig ();
+  ssize_t result;
+  int flags = epoll_fd < 0 ? FAIL : io_prepare (fd);
+  if (flags == FAIL)
+  {
+    unblock_sig (&old_set);
+    return read (fd, buf, count);
+  }
+  while ((result = io_attempt (fd, flags,
+                               [&] { return read (fd, buf, count); })) < 0
+         && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    io_wait (fd, false);
+  }
+  int saved_errno = errno;
+  unblock_sig (&old_set);
+  errno = saved_errno;
+  return result;
+}
+
+ssize_t uthread_write (int fd, const void *buf, size_t count)
+{
+  sigset_t old_set = block_sig ();
+  ssize_t result;
+  int flags = epoll_fd < 0 ? FAIL : io_prepare (fd);
+  if (flags == FAIL)
+  {
+    unblock_sig (&old_set);
+    return write (fd, buf, count);
+  }
+  while ((result = io_attempt (fd, flags,
+                               [&] { return write (fd, buf, count); })) < 0
+         && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    io_wait (fd, true);
+  }
+  int saved_errno = errno;
+  unblock_sig (&old_set);
+  errno = saved_errno;
+  return result;
+}
+
+int uthread_accept (int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+{
+  sigset_t old_set = block_sig ();
+  int result;
+  int flags = epoll_fd < 0 ? FAIL : io_prepare (sockfd);
+  if (flags == FAIL)
+  {
+    unblock_sig (&old_set);
+    return accept (sockfd, addr, addrlen);
+  }
+  while ((result = io_attempt (sockfd, flags,
+                               [&] { return accept (sockfd, addr, addrlen); }))
+         < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    io_wait (sockfd, false);
+  }
+  int saved_errno = errno;
+  unblock_sig (&old_set);
+  errno = saved_errno;
+  return result;
+}
+
+int uthread_connect (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+  sigset_t old_set = block_sig ();
+  int result;
+  int flags = epoll_fd < 0 ? FAIL : io_prepare (sockfd);
+  if (flags == FAIL)
+  {
+    unblock_sig (&old_set);
+    return connect (sockfd, addr, addrlen);
+  }
+  // a full UNIX socket backlog says EAGAIN: wait and knock again. A
+  // connection in progress goes on after the flag is taken back.
+  while ((result = io_attempt (sockfd, flags,
+                               [&] { return connect (sockfd, addr, addrlen); }))
+         < 0 && errno == EAGAIN)
+  {
+    io_wait (sockfd, true);
+  }
+  if (result < 0 && errno == EINPROGRESS)
+  {
+    io_wait (sockfd, true);
+    int error = 0;
+    socklen_t error_len = sizeof (error);
+    getsockopt (sockfd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+    result = error == 0 ? SUCCESS : FAIL;
+    errno = error;
+  }
+  int saved_errno = errno;
+  unblock_sig (&old_set);
+  errno = saved_errno;
+  return result;
+}
+
+int uthread_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  sigset_t old_set = block_sig ();
+  int result = poll (fds, nfds, 0);
+  if (result == 0 && timeout != 0)
+  {
+    result = epoll_fd < 0 ? poll (fds, nfds, timeout)
+                          : poll_wait (fds, nfds, timeout);
+  }
+  int saved_errno = errno;
+  unblock_sig (&old_set);
+  errno = saved_errno;
+  return result;
+}
+
+ssize_t uthread_pread (int fd, void *buf, size_t count, off_t offset)
+{
+  sigset_t old_set = block_sig ();
+  // a negative offset is EINVAL for pread, but io_uring reads at the file
+  // position for -1
+  if (file_ring.fd < 0 || offset < 0)
+  {
+    unblock_sig (&old_set);
+    return pread (fd, buf, count, offset);
+  }
+  io_uring_sqe request = {};
+  request.opcode = IORING_OP_READ;
+  request.fd = fd;
+  request.off = (__u64) offset;
+  request.addr = (__u64) buf;
+  request.len = (__u32) min (count, (size_t) INT32_MAX);
+  int result = uring_run (request);
+  unblock_sig (&old_set);
+  return uring_return (result);
+}
+
+ssize_t uthread_pwrite (int fd, const void *buf, size_t count, off_t offset)
+{
+  sigset_t old_set = block_sig ();
+  if (file_ring.fd < 0 || offset < 0)
+  {
+    unblock_sig (&old_set);
+    return pwrite (fd, buf, count, offset);
+  }
+  io_uring_sqe request = {};
+  request.opcode = IORING_OP_WRITE;
+  request.fd = fd;
+  request.off = (__u64) offset;
+  request.addr = (__u64) buf;
+  request.len = (__u32) min (count, (size_t) INT32_MAX);
+  int result = uring_run (request);
+  unblock_sig (&old_set);
+  return uring_return (result);
+}
+
+int uthread_fsync (int fd)
+{
+  sigset_t old_set = block_sig ();
+  if (file_ring.fd < 0)
+  {
+    unblock_sig (&old_set);
+    return fsync (fd);
+  }
+  io_uring_sqe request = {};
+  request.opcode = IORING_OP_FSYNC;
+  request.fd = fd;
+  int result = uring_run (request);
+  unblock_sig (&old_set);
+  return (int) uring_return (result);
+}
+
+int uthread_in_thread ()
+{
+  if (quantum_len == 0)
+  {
+    return 0;
+  }
+  sigset_t current;
+  sigprocmask (SIG_BLOCK, nullptr, &current);
+  return !sigismember (&current, tick_signal);
+}
+
+int uthread_mutex_lock (uthread_mutex_t *mutex)
+{
+  sigset_t old_set = block_sig ();
+  if (mutex->locked && mutex->owner == running_process_id)
+  {
+    fprintf (stderr, "thread library error: mutex is already locked by this "
+                     "thread\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  mutex_acquire (mutex);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_mutex_trylock (uthread_mutex_t *mutex)
+{
+  sigset_t old_set = block_sig ();
+  int result = FAIL;
+  if (!mutex->locked)
+  {
+    mutex_take (mutex);
+    result = SUCCESS;
+  }
+  unblock_sig (&old_set);
+  return result;
+}
+
+int uthread_mutex_unlock (uthread_mutex_t *mutex)
+{
+  sigset_t old_set = block_sig ();
+  if (!mutex->locked || mutex->owner != running_process_id)
+  {
+    fprintf (stderr, "thread library error: mutex is not locked by this "
+                     "thread\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  mutex_release (mutex);
+  yield_to_higher ();
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_cond_wait (uthread_cond_t *cond, uthread_mutex_t *mutex)
+{
+  sigset_t old_set = block_sig ();
+  if (!mutex->locked || mutex->owner != running_process_id)
+  {
+    fprintf (stderr, "thread library error: mutex is not locked by this "
+                     "thread\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  // nobody runs between enqueueing and parking, so no signal is missed
+  wait_node node = {running_process_id, nullptr, nullptr, nullptr};
+  wait_enqueue (&cond->waiters, &node);
+  mutex_release (mutex);
+  park (&node);
+  mutex_acquire (mutex);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_cond_signal (uthread_cond_t *cond)
+{
+  sigset_t old_set = block_sig ();
+  wake_one (&cond->waiters);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_cond_broadcast (uthread_cond_t *cond)
+{
+  sigset_t old_set = block_sig ();
+  wake_all (&cond->waiters);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_barrier_init (uthread_barrier_t *barrier, int count)
+{
+  if (barrier == nullptr || count <= 0)
+  {
+    fprintf (stderr, "thread library error: count should be positive\n");
+    return FAIL;
+  }
+  *barrier = UTHREAD_BARRIER_INITIALIZER (count);
+  return SUCCESS;
+}
+
+int uthread_barrier_wait (uthread_barrier_t *barrier)
+{
+  sigset_t old_set = block_sig ();
+  if (barrier == nullptr || barrier->count <= 0)
+  {
+    fprintf (stderr, "thread library error: barrier is not initialized\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (++barrier->arrived == barrier->count)
+  {
+    barrier->arrived = 0;
+    barrier->generation++;
+    wake_all (&barrier->waiters);
+    unblock_sig (&old_set);
+    return UTHREAD_BARRIER_SERIAL_THREAD;
+  }
+  // a thread woken late must not take the next round's release for its own
+  unsigned int generation = barrier->generation;
+  while (barrier->generation == generation)
+  {
+    wait_on (&barrier->waiters);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_latch_init (uthread_latch_t *latch, int count)
+{
+  if (latch == nullptr || count < 0)
+  {
+    fprintf (stderr, "thread library error: count cannot be negative\n");
+    return FAIL;
+  }
+  *latch = UTHREAD_LATCH_INITIALIZER (count);
+  return SUCCESS;
+}
+
+int uthread_latch_count_down (uthread_latch_t *latch, int n)
+{
+  sigset_t old_set = block_sig ();
+  if (latch == nullptr || n <= 0 || n > latch->count)
+  {
+    fprintf (stderr, "thread library error: counting down below zero\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  latch->count -= n;
+  if (latch->count == 0)
+  {
+    wake_all (&latch->waiters);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_latch_wait (uthread_latch_t *latch)
+{
+  sigset_t old_set = block_sig ();
+  if (latch == nullptr)
+  {
+    fprintf (stderr, "thread library error: no latch\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  while (latch->count > 0)
+  {
+    wait_on (&latch->waiters);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_rwlock_rdlock (uthread_rwlock_t *rwlock)
+{
+  sigset_t old_set = block_sig ();
+  if (rwlock->writer || rwlock->write_waiters.head != nullptr)
+  {
+    wait_on (&rwlock->read_waiters); // woken holding it
+    thread_contexts[running_process_id].handed = nullptr;
+  }
+  else
+  {
+    rwlock->readers++;
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_rwlock_wrlock (uthread_rwlock_t *rwlock)
+{
+  sigset_t old_set = block_sig ();
+  if (rwlock->writer || rwlock->readers > 0
+      || rwlock->write_waiters.head != nullptr)
+  {
+    wait_on (&rwlock->write_waiters); // woken holding it
+    thread_contexts[running_process_id].handed = nullptr;
+  }
+  else
+  {
+    rwlock->writer = 1;
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_rwlock_unlock (uthread_rwlock_t *rwlock)
+{
+  sigset_t old_set = block_sig ();
+  if (!rwlock->writer && rwlock->readers == 0)
+  {
+    fprintf (stderr, "thread library error: rwlock is not locked\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  rwlock_release (rwlock);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_wait_on (const volatile int *address, int expected)
+{
+  if (address == nullptr)
+  {
+    fprintf (stderr, "thread library error: no address to wait on\n");
+    return FAIL;
+  }
+  sigset_t old_set = block_sig ();
+  // checked with the tick blocked: no wake can slip in before the park
+  if (*address != expected)
+  {
+    unblock_sig (&old_set);
+    errno = EAGAIN;
+    return FAIL;
+  }
+  wait_node node = {running_process_id, nullptr, nullptr, nullptr};
+  wait_enqueue (&address_bucket (address), &node);
+  thread_contexts[running_process_id].wait_address = address;
+  park (&node);
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_wake (const volatile int *address, int n)
+{
+  if (address == nullptr || n <= 0)
+  {
+    fprintf (stderr, "thread library error: n should be positive\n");
+    return FAIL;
+  }
+  sigset_t old_set = block_sig ();
+  int woken = 0;
+  wait_node *node = address_bucket (address).head;
+  while (node != nullptr && woken < n)
+  {
+    wait_node *next = node->next;
+    if (thread_contexts[node->tid].wait_address == address)
+    {
+      wait_unlink (node);
+      wake_thread (node->tid);
+      woken++;
     }
-    else
+    node = next;
+  }
+  unblock_sig (&old_set);
+  return woken;
+}
+
+int uthread_channel_init (uthread_channel_t *channel, void **slots,
+                          int capacity)
+{
+  if (channel == nullptr || slots == nullptr || capacity <= 0)
+  {
+    fprintf (stderr, "thread library error: capacity should be positive\n");
+    return FAIL;
+  }
+  *channel = UTHREAD_CHANNEL_INITIALIZER (slots, capacity);
+  return SUCCESS;
+}
+
+int uthread_channel_send (uthread_channel_t *channel, void *message)
+{
+  if (channel == nullptr || channel->capacity <= 0)
+  {
+    fprintf (stderr, "thread library error: channel is not initialized\n");
+    return FAIL;
+  }
+  sigset_t old_set = block_sig ();
+  while (!channel_put (channel, message))
+  {
+    wait_on (&channel->senders);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_channel_receive (uthread_channel_t *channel, void **message)
+{
+  if (channel == nullptr || channel->capacity <= 0 || message == nullptr)
+  {
+    fprintf (stderr, "thread library error: channel is not initialized\n");
+    return FAIL;
+  }
+  sigset_t old_set = block_sig ();
+  while (!channel_take (channel, message))
+  {
+    wait_on (&channel->receivers);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
+
+int uthread_select (uthread_select_case *cases, int amount, long timeout_usecs)
+{
+  sigset_t old_set = block_sig ();
+  if (cases == nullptr || amount <= 0 || amount > UTHREAD_SELECT_MAX_CASES
+      || !select_valid (cases, amount))
+  {
+    fprintf (stderr, "thread library error: invalid select cases\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  long long deadline = timeout_usecs > 0
+                       ? monotonic_ns () + timeout_usecs * 1000LL : 0;
+  wait_node nodes[UTHREAD_SELECT_MAX_CASES];
+  select_wait select = {cases, nodes, amount, -1};
+  int done = FAIL;
+  while (true)
+  {
+    // the case that woke us first: that wake up was meant for it
+    if (select.winner >= 0 && select_try (cases[select.winner]))
     {
-      threads[tid]->_state = RUN; // when it will wake up it will return to
-      // ready
+      done = select.winner;
+      break;
     }
+    for (int i = 0; i < amount && done == FAIL; i++)
+    {
+      if (select_try (cases[i]))
+      {
+        done = i;
+      }
+    }
+    if (done != FAIL || timeout_usecs == 0
+        || (deadline > 0 && monotonic_ns () >= deadline))
+    {
+      break;
+    }
+    for (int i = 0; i < amount; i++)
+    {
+      nodes[i] = {running_process_id, nullptr, nullptr, nullptr};
+      wait_enqueue (select_queue (cases[i]), &nodes[i]);
+      if (cases[i].kind == UTHREAD_SELECT_READ
+          || cases[i].kind == UTHREAD_SELECT_WRITE)
+      {
+        fd_update_interest (cases[i].fd);
+      }
+    }
+    if (deadline > 0)
+    {
+      deadline_push (running_process_id,
+                     round_up (deadline, slack_of (running_process_id)));
+      arm_tick ();
+    }
+    select.winner = -1;
+    thread_contexts[running_process_id].select = &select;
+    park (&nodes[0]);
+  }
+  unblock_sig (&old_set);
+  if (done == FAIL)
+  {
+    errno = ETIMEDOUT;
+  }
+  return done;
+}
+
+uthread_generator_t *uthread_generator_create (uthread_generator_body body,
+                                               void *arg, int stack_size)
+{
+  if (stack_size == 0)
+  {
+    stack_size = STACK_SIZE;
+  }
+  if (body == nullptr || stack_size < STACK_MIN_CLASS)
+  {
+    fprintf (stderr, "thread library error: a generator needs a body and at "
+                     "least %d bytes of stack\n", STACK_MIN_CLASS);
+    return nullptr;
+  }
+  stack_size = (int) round_up (stack_size, 16); // keeps the first frame aligned
+  uthread_generator_t *generator = new uthread_generator_t ();
+  generator->stack = new char[stack_size];
+  generator->body = body;
+  generator->arg = arg;
+  setup_context (generator->env, generator->stack, stack_size, generator_main);
+  generator->env->__mask_was_saved = 0; // a switch is no system call
+  return generator;
+}
+
+int uthread_generator_resume (uthread_generator_t *generator, void **value)
+{
+  if (generator == nullptr || generator->running)
+  {
+    fprintf (stderr, "thread library error: the generator is running\n");
+    return FAIL;
+  }
+  if (generator->finished)
+  {
+    return 0;
+  }
+  generator->outer = thread_contexts[running_process_id].generator;
+  generator->running = true;
+  thread_contexts[running_process_id].generator = generator;
+  if (sigsetjmp (generator->caller, 0) == 0)
+  {
+    siglongjmp (generator->env, 1);
+  }
+  if (generator->finished)
+  {
+    return 0;
+  }
+  if (value != nullptr)
+  {
+    *value = generator->value;
+  }
+  return 1;
+}
+
+int uthread_yield_value (void *value)
+{
+  uthread_generator_t *generator = thread_contexts[running_process_id].generator;
+  if (generator == nullptr)
+  {
+    fprintf (stderr, "thread library error: not in a generator\n");
+    return FAIL;
   }
-  unblock_sig (old_set);
+  generator->value = value;
+  generator_leave (generator);
   return SUCCESS;
 }
 
-int uthread_sleep (int num_quantums)
+int uthread_generator_destroy (uthread_generator_t *generator)
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_sleep. running is %d, parameter is "
-          "%d\n",
-          running_process_id, num_quantums);
+  if (generator == nullptr || generator->running)
+  {
+    fprintf (stderr, "thread library error: the generator is running\n");
+    return FAIL;
+  }
+  delete[] generator->stack;
+  delete generator;
+  return SUCCESS;
+}
 
-  if (running_process_id == 0)
+int uthread_post (thread_entry_point_arg task, void *arg)
+{
+  if (task == nullptr)
   {
-    printf ("thread library error: cant put to sleep the main thread\n");
-    fflush (stderr);
+    fprintf (stderr, "thread library error: no task to post\n");
     return FAIL;
   }
-  if (num_quantums <= 0)
-  { // todo: needs to be positive or not-negative?
-    printf ("thread library error: num_quantums should be positive\n");
-    fflush (stderr);
+  unsigned long position = __atomic_load_n (&post_tail, __ATOMIC_RELAXED);
+  posted_task *slot;
+  while (true)
+  {
+    slot = &posted_tasks[position % MAX_POSTED_TASKS];
+    unsigned long turn = __atomic_load_n (&slot->turn, __ATOMIC_ACQUIRE);
+    unsigned long lap = position / MAX_POSTED_TASKS * 2;
+    if (turn < lap)
+    {
+      return FAIL; // full: the task of the lap before has not run yet
+    }
+    if (turn == lap)
+    {
+      if (__atomic_compare_exchange_n (&post_tail, &position, position + 1,
+                                       false, __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else
+    {
+      position = __atomic_load_n (&post_tail, __ATOMIC_RELAXED);
+    }
+  }
+  slot->task = task;
+  slot->arg = arg;
+  __atomic_store_n (&slot->turn, position / MAX_POSTED_TASKS * 2 + 1,
+                    __ATOMIC_RELEASE);
+  return SUCCESS;
+}
+
+int uthread_set_task_share (int percent)
+{
+  if (percent < 0 || percent > 100)
+  {
+    fprintf (stderr, "thread library error: the share is a percentage\n");
     return FAIL;
   }
-  // todo: make sure it should be +1 (since the current doesnt count)
-  threads[running_process_id]->_remain_sleep_time = num_quantums + 1;
-  sleepings.insert (sleepings.begin (), running_process_id);
-  if (threads[running_process_id]->_state != BLOCKED)
+  task_share = percent;
+  return SUCCESS;
+}
+
+uthread_executor_t *uthread_executor_create (int workers, int capacity)
+{
+  sigset_t old_set = block_sig ();
+  if (workers <= 0 || capacity <= 0
+      || workers > MAX_THREAD_NUM - 1 - current_threads_amount) // main is not counted
   {
-    return schedule (SLEEPING);
+    fprintf (stderr, "thread library error: no room for %d workers\n",
+             workers);
+    unblock_sig (&old_set);
+    return nullptr;
   }
-  int return_value = schedule (BLOCKED);
-  unblock_sig (old_set);
-  return return_value;
+  uthread_executor_t *executor = new uthread_executor_t ();
+  executor->items = new work_item[capacity];
+  executor->capacity = capacity;
+  executor->workers = new int[workers];
+  executor->worker_amount = workers;
+  executor->alive = workers;
+  for (int i = 0; i < workers; i++)
+  {
+    executor->workers[i] = spawn_thread ((thread_entry_point) executor_worker,
+                                         executor_worker, executor);
+    thread_contexts[executor->workers[i]].pool_worker = true;
+  }
+  unblock_sig (&old_set);
+  return executor;
 }
 
-int uthread_get_tid ()
+int uthread_executor_submit (uthread_executor_t *executor, uthread_work_fn work,
+                             void *arg, uthread_future_t *future)
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_get_tid. running is %d"
-          "\n", running_process_id);
-  unblock_sig (old_set);
-  return running_process_id;
+  sigset_t old_set = block_sig ();
+  if (executor == nullptr || work == nullptr || executor->shutting_down)
+  {
+    fprintf (stderr, "thread library error: no work or no executor\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  while (executor->count == executor->capacity && !executor->shutting_down)
+  {
+    executor->parked_submitters++;
+    wait_on (&executor->submitters);
+    // the executor may be freed as soon as the last submitter has looked
+    if (--executor->parked_submitters == 0 && executor->shutting_down)
+    {
+      wake_all (&executor->shutdown_waiters);
+    }
+  }
+  if (executor->shutting_down)
+  {
+    fprintf (stderr, "thread library error: the executor shut down\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  if (future != nullptr)
+  {
+    *future = UTHREAD_FUTURE_INITIALIZER;
+  }
+  executor->items[(executor->head + executor->count) % executor->capacity] =
+      {work, arg, future};
+  executor->count++;
+  wake_one (&executor->idle_workers);
+  unblock_sig (&old_set);
+  return SUCCESS;
 }
 
-int uthread_get_total_quantums ()
+int uthread_future_wait (uthread_future_t *future, void **result)
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_get_total_quantums. running is %d\n",
-          running_process_id);
-  // todo: what does it means "including the current"?
-  unblock_sig (old_set);
-  return total_tick;
+  if (future == nullptr)
+  {
+    fprintf (stderr, "thread library error: no future\n");
+    return FAIL;
+  }
+  sigset_t old_set = block_sig ();
+  while (!future->done)
+  {
+    wait_on (&future->waiters);
+  }
+  if (result != nullptr)
+  {
+    *result = future->result;
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
 }
 
-int uthread_get_quantums (int tid)
+int uthread_executor_shutdown (uthread_executor_t *executor)
 {
-  sigset_t *old_set = block_sig ();
-  printf ("ASASAS enter function uthread_get_quantums. running is %d\n",
-          running_process_id);
-  if (is_exists (tid) == FAIL)
+  sigset_t old_set = block_sig ();
+  if (executor == nullptr || executor->shutting_down
+      || count (executor->workers, executor->workers + executor->worker_amount,
+                running_process_id) > 0)
   {
+    fprintf (stderr, "thread library error: the executor cannot be shut down "
+                     "from here\n");
+    unblock_sig (&old_set);
     return FAIL;
   }
-  unblock_sig (old_set);
-  return threads[tid]->_quantums;
+  executor->shutting_down = true;
+  wake_all (&executor->idle_workers);
+  wake_all (&executor->submitters);
+  while (executor->alive > 0 || executor->parked_submitters > 0)
+  {
+    wait_on (&executor->shutdown_waiters);
+  }
+  unblock_sig (&old_set);
+  delete[] executor->items;
+  delete[] executor->workers;
+  delete executor;
+  return SUCCESS;
+}
+
+uthread_actor_system_t *uthread_actor_system_create (int workers, int batch)
+{
+  sigset_t old_set = block_sig ();
+  if (workers <= 0 || batch <= 0
+      || workers > MAX_THREAD_NUM - 1 - current_threads_amount) // main is not counted
+  {
+    fprintf (stderr, "thread library error: no room for %d workers\n",
+             workers);
+    unblock_sig (&old_set);
+    return nullptr;
+  }
+  uthread_actor_system_t *system = new uthread_actor_system_t ();
+  system->batch = batch;
+  system->workers = new int[workers];
+  system->worker_amount = workers;
+  system->alive = workers;
+  for (int i = 0; i < workers; i++)
+  {
+    system->workers[i] = spawn_thread ((thread_entry_point) actor_worker,
+                                       actor_worker, system);
+    thread_contexts[system->workers[i]].pool_worker = true;
+  }
+  unblock_sig (&old_set);
+  return system;
 }
 
+int uthread_actor_init (uthread_actor_t *actor, uthread_actor_system_t *system,
+                        uthread_actor_fn behavior, void *state)
+{
+  if (actor == nullptr || system == nullptr || behavior == nullptr)
+  {
+    fprintf (stderr, "thread library error: no actor, system or behavior\n");
+    return FAIL;
+  }
+  *actor = {behavior, state, system, nullptr, nullptr, nullptr, 0};
+  return SUCCESS;
+}
 
+int uthread_actor_send (uthread_actor_t *actor, uthread_message_t *message)
+{
+  sigset_t old_set = block_sig ();
+  // the system is still there while shutdown waits for the workers; after
+  // that it is freed, and sending is the caller's error
+  if (actor == nullptr || message == nullptr || actor->system->shutting_down)
+  {
+    fprintf (stderr, "thread library error: no actor or message\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  message->next = nullptr;
+  if (actor->last == nullptr)
+  {
+    actor->first = message;
+  }
+  else
+  {
+    actor->last->next = message;
+  }
+  actor->last = message;
+  if (!actor->scheduled)
+  {
+    actor->scheduled = 1;
+    actor_schedule (actor->system, actor);
+    wake_one (&actor->system->idle_workers);
+  }
+  unblock_sig (&old_set);
+  return SUCCESS;
+}
 
+int uthread_actor_system_shutdown (uthread_actor_system_t *system)
+{
+  sigset_t old_set = block_sig ();
+  if (system == nullptr || system->shutting_down
+      || count (system->workers, system->workers + system->worker_amount,
+                running_process_id) > 0)
+  {
+    fprintf (stderr, "thread library error: the actor system cannot be shut "
+                     "down from here\n");
+    unblock_sig (&old_set);
+    return FAIL;
+  }
+  while (system->busy > 0 || system->first_scheduled != nullptr)
+  {
+    wait_on (&system->quiet_waiters);
+  }
+  system->shutting_down = true;
+  wake_all (&system->idle_workers);
+  while (system->alive > 0)
+  {
+    wait_on (&system->shutdown_waiters);
+  }
+  unblock_sig (&old_set);
+  delete[] system->workers;
+  delete system;
+  return SUCCESS;
+}
@@ -7,11 +7,170 @@
 #ifndef _UTHREADS_H
 #define _UTHREADS_H
 
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <poll.h>
 
 #define MAX_THREAD_NUM 100 /* maximal number of threads */
+#define MAX_TIMER_NUM 128 /* maximal number of callback timers */
+#define MAX_POSTED_TASKS 4096 /* maximal number of tasks posted and not run yet */
 #define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define UTHREAD_PRIORITY_LEVELS 8 /* priorities go from 0, every thread's at spawn, up to UTHREAD_PRIORITY_LEVELS - 1 */
+
+/* Clock sources for uthread_init_clock, and the signal each one takes over */
+#define UTHREAD_CLOCK_VIRTUAL 0 /* ITIMER_VIRTUAL, SIGVTALRM: user CPU time of the process (uthread_init) */
+#define UTHREAD_CLOCK_PROF 1 /* ITIMER_PROF, SIGPROF: user and system CPU time of the process */
+#define UTHREAD_CLOCK_REAL 2 /* ITIMER_REAL, SIGALRM: wall clock time */
+#define UTHREAD_CLOCK_POSIX 3 /* CLOCK_MONOTONIC POSIX timer, SIGRTMIN, sent to the initializing kernel thread */
 
 typedef void (*thread_entry_point)(void);
+typedef void (*thread_entry_point_arg)(void *);
+typedef void (*uthread_timer_callback)(void *);
+
+struct uthread_wait_node;
+
+/* FIFO of threads parked on a mutex or condition variable; internal to the library */
+typedef struct uthread_wait_queue
+{
+    struct uthread_wait_node *head;
+    struct uthread_wait_node *tail;
+} uthread_wait_queue;
+
+/* A mutex for threads of this library; all zeros (UTHREAD_MUTEX_INITIALIZER) is an unlocked mutex */
+typedef struct uthread_mutex
+{
+    int locked;
+    int owner; /* tid of the holder, while locked */
+    uthread_wait_queue waiters;
+    struct uthread_mutex *next_held; /* the next mutex its holder holds; internal to the library */
+} uthread_mutex_t;
+
+#define UTHREAD_MUTEX_INITIALIZER {0, 0, {0, 0}, 0}
+
+/* A condition variable for threads of this library; all zeros (UTHREAD_COND_INITIALIZER) is a valid one */
+typedef struct uthread_cond
+{
+    uthread_wait_queue waiters;
+} uthread_cond_t;
+
+#define UTHREAD_COND_INITIALIZER {{0, 0}}
+
+/* A reader-writer lock that prefers writers; all zeros (UTHREAD_RWLOCK_INITIALIZER) is an unlocked one */
+typedef struct uthread_rwlock
+{
+    int readers; /* holding it */
+    int writer; /* 1 while a writer holds it */
+    uthread_wait_queue read_waiters;
+    uthread_wait_queue write_waiters;
+} uthread_rwlock_t;
+
+#define UTHREAD_RWLOCK_INITIALIZER {0, 0, {0, 0}, {0, 0}}
+
+/* A barrier for count threads a round (uthread_barrier_init or UTHREAD_BARRIER_INITIALIZER(count)) */
+typedef struct uthread_barrier
+{
+    int count;
+    int arrived; /* in the current round */
+    unsigned int generation; /* rounds completed */
+    uthread_wait_queue waiters;
+} uthread_barrier_t;
+
+#define UTHREAD_BARRIER_INITIALIZER(count) {(count), 0, 0, {0, 0}}
+#define UTHREAD_BARRIER_SERIAL_THREAD 1 /* returned to one thread a round, the last to arrive */
+
+/* A single-use countdown latch (uthread_latch_init or UTHREAD_LATCH_INITIALIZER(count)) */
+typedef struct uthread_latch
+{
+    int count;
+    uthread_wait_queue waiters;
+} uthread_latch_t;
+
+#define UTHREAD_LATCH_INITIALIZER(count) {(count), {0, 0}}
+
+/* A bounded FIFO of messages (uthread_channel_init or UTHREAD_CHANNEL_INITIALIZER); slots holds capacity of them */
+typedef struct uthread_channel
+{
+    void **slots;
+    int capacity;
+    int head; /* slot of the oldest message */
+    int count; /* messages in it */
+    uthread_wait_queue receivers; /* parked while it is empty */
+    uthread_wait_queue senders; /* parked while it is full */
+} uthread_channel_t;
+
+#define UTHREAD_CHANNEL_INITIALIZER(slots, capacity) {(slots), (capacity), 0, 0, {0, 0}, {0, 0}}
+
+/* What a case of uthread_select waits for */
+#define UTHREAD_SELECT_RECEIVE 0 /* a message on channel, stored to message */
+#define UTHREAD_SELECT_SEND 1 /* room on channel for message */
+#define UTHREAD_SELECT_READ 2 /* fd readable */
+#define UTHREAD_SELECT_WRITE 3 /* fd writable */
+#define UTHREAD_SELECT_MAX_CASES 8 /* cases of one uthread_select */
+
+typedef struct uthread_select_case
+{
+    int kind; /* UTHREAD_SELECT_RECEIVE, _SEND, _READ or _WRITE */
+    uthread_channel_t *channel; /* for _RECEIVE and _SEND */
+    void *message; /* sent by _SEND; the one received by _RECEIVE */
+    int fd; /* for _READ and _WRITE */
+} uthread_select_case;
+
+/* The tasks spawned into a group and not finished yet; all zeros (UTHREAD_TASK_GROUP_INITIALIZER) is an empty group */
+typedef struct uthread_task_group
+{
+    int pending;
+    uthread_wait_queue waiters; /* parked in uthread_task_group_wait */
+} uthread_task_group_t;
+
+#define UTHREAD_TASK_GROUP_INITIALIZER {0, {0, 0}}
+#define UTHREAD_RAN_INLINE (-2) /* uthread_task_group_spawn ran the task in the caller, as no thread id was free */
+
+/* The result of work submitted to an executor; all zeros (UTHREAD_FUTURE_INITIALIZER) is one not done yet */
+typedef struct uthread_future
+{
+    int done; /* 1 once result is set */
+    void *result;
+    uthread_wait_queue waiters; /* parked in uthread_future_wait */
+} uthread_future_t;
+
+#define UTHREAD_FUTURE_INITIALIZER {0, 0, {0, 0}}
+
+/* A fixed pool of worker threads that run submitted work (uthread_executor_create) */
+typedef struct uthread_executor uthread_executor_t;
+typedef void *(*uthread_work_fn)(void *arg);
+
+/* A message to an actor, linked into its mailbox; its storage belongs to the sender */
+typedef struct uthread_message
+{
+    struct uthread_message *next;
+    void *data;
+} uthread_message_t;
+
+/* A pool of worker threads that runs actors while they have messages (uthread_actor_system_create) */
+typedef struct uthread_actor_system uthread_actor_system_t;
+typedef struct uthread_actor uthread_actor_t;
+
+/* What an actor does with a batch of its messages, linked oldest first through next */
+typedef void (*uthread_actor_fn)(uthread_actor_t *actor, uthread_message_t *batch);
+
+/* A behavior, its state and a mailbox, with no thread of its own (uthread_actor_init) */
+struct uthread_actor
+{
+    uthread_actor_fn behavior;
+    void *state;
+    uthread_actor_system_t *system;
+    uthread_message_t *first; /* the mailbox, oldest first */
+    uthread_message_t *last;
+    uthread_actor_t *next_scheduled; /* in the system's queue of actors with messages */
+    int scheduled; /* 1 while queued or running */
+};
+
+/* The work of uthread_parallel_for on the indices begin..end-1 */
+typedef void (*uthread_range_body)(long begin, long end, void *arg);
+
+/* A generator (uthread_generator_create): a body on a stack of its own that hands values back as it goes */
+typedef struct uthread_generator uthread_generator_t;
+typedef void (*uthread_generator_body)(void *arg);
 
 /* External interface */
 
@@ -30,6 +189,22 @@ typedef void (*thread_entry_point)(void);
 */
 int uthread_init(int quantum_usecs);
 
+
+/**
+ * @brief initializes the thread library, like uthread_init, with the quanta measured on clock_source.
+ *
+ * uthread_init uses UTHREAD_CLOCK_VIRTUAL, which only advances while the process runs user code. The wall clock
+ * sources (UTHREAD_CLOCK_REAL, UTHREAD_CLOCK_POSIX) keep counting quantums while every thread waits for I/O or sleeps,
+ * which suits I/O-heavy programs. The signal of the chosen source belongs to the library from then on (for example,
+ * alarm() cannot be used with UTHREAD_CLOCK_REAL). Ticks the kernel merges because the signal was blocked or late
+ * are counted as the quantums they stand for, by the timer's overrun count (UTHREAD_CLOCK_POSIX) or by reading the
+ * clock back (UTHREAD_CLOCK_PROF, UTHREAD_CLOCK_REAL); the virtual clock cannot be read back, so there every tick
+ * counts one quantum.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_init_clock(int quantum_usecs, int clock_source);
+
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
  * void entry_point(void).
@@ -45,12 +220,25 @@ int uthread_init(int quantum_usecs);
 int uthread_spawn(thread_entry_point entry_point);
 
 
+/**
+ * @brief Creates a new thread, like uthread_spawn, whose entry point is entry_point(arg).
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_arg(thread_entry_point_arg entry_point, void *arg);
+
+
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
- * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it
- * is considered an error. Terminating the main thread (tid == 0) will result in the termination of the entire
- * process using exit(0) (after releasing the assigned library memory).
+ * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it is
+ * considered an error. The thread's stack is not freed on the spot (a thread terminating itself is still running on
+ * it): it is reaped together with other terminated threads from the scheduler and kept for reuse by later spawns. A
+ * thread whose entry point returns is terminated as if it had called this function on itself. The mutexes the thread
+ * holds are unlocked as if it had unlocked them, and the priority it lent the holder of a mutex it waited for is taken
+ * back. Terminating the main thread (tid == 0) will result in the termination of the entire process using exit(0)
+ * (after releasing the assigned library memory). It is an error to terminate a worker of an executor or an actor
+ * system: it ends when its pool shuts down.
  *
  * @return The function returns 0 if the thread was successfully terminated and -1 otherwise. If a thread terminates
  * itself or the main thread is terminated, the function does not return.
@@ -97,6 +285,145 @@ int uthread_resume(int tid);
 int uthread_sleep(int num_quantums);
 
 
+/**
+ * @brief Blocks the RUNNING thread for at least usecs microseconds.
+ *
+ * Same as uthread_sleep_until with a deadline usecs from now.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_us(unsigned long usecs);
+
+
+/**
+ * @brief Blocks the RUNNING thread until CLOCK_MONOTONIC reaches abs_ns nanoseconds.
+ *
+ * Unlike uthread_sleep this is not counted in quantums: the timer is armed for the earlier of the end of the running
+ * quantum and the first deadline, so the thread moves to the end of the READY queue at its deadline, while the
+ * running thread keeps the rest of its quantum. The main thread may sleep this way too. A deadline in the past
+ * returns at once.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_until(long long abs_ns);
+
+
+/**
+ * @brief Sets the timer slack of every thread that has none of its own (0 when the library starts).
+ *
+ * A sleep may end up to its thread's slack late, never early: wake times are rounded up to a multiple of the slack,
+ * so many sleeps that end close together wake in one scheduler pass, on one timer tick, instead of one each. For
+ * uthread_sleep the slack counts in whole quantums (a slack below two quantums keeps it exact). A larger slack means
+ * fewer ticks and switches under many sleepers, a smaller one more precise wake ups.
+ *
+ * @return On success, return 0. On failure (a negative slack), return -1.
+*/
+int uthread_set_timer_slack(long usecs);
+
+
+/**
+ * @brief Gives the thread with ID tid a timer slack of its own, or (usecs < 0) makes it follow uthread_set_timer_slack.
+ *
+ * Applies to the sleeps the thread starts afterwards.
+ *
+ * @return On success, return 0. On failure (no thread with ID tid exists), return -1.
+*/
+int uthread_set_thread_slack(int tid, long usecs);
+
+
+/**
+ * @brief Sets the priority of the thread with ID tid, from 0 to UTHREAD_PRIORITY_LEVELS - 1 (the most urgent).
+ *
+ * The scheduler always runs a READY thread of the highest priority there is, round-robin among equals, so lower
+ * priorities run only while no higher one is READY. A thread holding a mutex that a more urgent thread waits for runs
+ * with the waiter's priority until it unlocks the mutex (priority inheritance, through chains of holders as well).
+ * If a READY thread then outranks the RUNNING one, it runs at once.
+ *
+ * @return On success, return 0. On failure (no such thread or priority), return -1.
+*/
+int uthread_set_priority(int tid, int priority);
+
+
+/**
+ * @brief Returns the priority the thread with ID tid runs with now: the one it was given, or an inherited higher one.
+ *
+ * @return On success, return the priority. On failure (no thread with ID tid exists), return -1.
+*/
+int uthread_get_priority(int tid);
+
+
+/**
+ * @brief Runs task(arg) as a new thread that belongs to group, for uthread_task_group_wait.
+ *
+ * When no thread id is free the caller runs the task itself before returning, so a recursive fan-out degrades to
+ * plain calls instead of failing. The task's thread ends when task returns or is terminated.
+ *
+ * @return On success, the task's thread id, or UTHREAD_RAN_INLINE if the caller ran it. On failure (no group or
+ * task), return -1.
+*/
+int uthread_task_group_spawn(uthread_task_group_t *group, thread_entry_point_arg task, void *arg);
+
+
+/**
+ * @brief Blocks the RUNNING thread until every task spawned into group so far has finished.
+ *
+ * The thread parks on the group's join counter, not spinning, and the group can be reused after it returns. A task
+ * must not wait for the group it belongs to.
+ *
+ * @return On success, return 0. On failure (no group), return -1.
+*/
+int uthread_task_group_wait(uthread_task_group_t *group);
+
+
+/**
+ * @brief Calls body on the whole range begin..end-1, in pieces of at most grain indices run by parallel tasks.
+ *
+ * The range is split in halves: the thread that splits keeps the left half and spawns a task for the right one, which
+ * splits it in turn, until the pieces are no longer than grain. When no thread id is free, a thread runs the rest of
+ * its half itself, a grain at a time. Every index is passed to body exactly once, on a STACK_SIZE stack, and the call
+ * returns when all of body's calls have. Nothing in it depends on how many cores the scheduler runs on.
+ *
+ * @return On success, return 0. On failure (grain is not positive or body is missing), return -1.
+*/
+int uthread_parallel_for(long begin, long end, long grain, uthread_range_body body, void *arg);
+
+
+/**
+ * @brief Creates a timer that calls callback(arg) first_usecs from now, and then every period_usecs (once, if 0).
+ *
+ * The callbacks of all timers run on one thread of the library's own, started with the first timer: the timers that
+ * come due together run in one batch, in the order they came due, without a thread and a context switch each. A
+ * callback runs on a STACK_SIZE stack and holds up the callbacks after it for as long as it runs, so it should be
+ * short; it may create, reschedule and cancel timers, its own included. A periodic timer keeps its phase and skips
+ * the periods that passed while its callback was held up. The timers share the deadline heap of uthread_sleep_until
+ * and follow the global timer slack (uthread_set_timer_slack). The timer stays until uthread_timer_cancel, a one-shot
+ * timer that has fired included, so uthread_timer_reschedule can arm it again.
+ *
+ * @return On success, the timer's handle, a number between 0 and MAX_TIMER_NUM - 1. On failure (no callback, no
+ * timer or, for the first one, no thread id left), return -1.
+*/
+int uthread_timer_create(uthread_timer_callback callback, void *arg, unsigned long first_usecs,
+                         unsigned long period_usecs);
+
+
+/**
+ * @brief Re-arms timer to fire first_usecs from now, and then every period_usecs (once, if 0).
+ *
+ * A call that was due but has not run yet is dropped.
+ *
+ * @return On success, return 0. On failure (no such timer), return -1.
+*/
+int uthread_timer_reschedule(int timer, unsigned long first_usecs, unsigned long period_usecs);
+
+
+/**
+ * @brief Disarms timer and frees its handle. A call that was due but has not run yet is dropped.
+ *
+ * @return On success, return 0. On failure (no such timer), return -1.
+*/
+int uthread_timer_cancel(int timer);
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
@@ -128,4 +455,496 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Turns stack painting on or off for threads spawned after this call.
+ *
+ * A painted thread has its whole stack filled with a known byte pattern when it is spawned, so that the deepest
+ * byte it ever touched can be found later by scanning for the first overwritten byte. Painting costs one memset of
+ * STACK_SIZE bytes per spawn and is off by default.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_stack_painting(int enable);
+
+
+/**
+ * @brief Returns the stack high-water mark of the thread with ID tid.
+ *
+ * It is an error to call this function for a thread that does not exist or that was spawned while stack painting
+ * was off (this includes the main thread, which uses the regular stack).
+ *
+ * @return On success, return the number of stack bytes the thread has used at its deepest point. On failure,
+ * return -1.
+*/
+int uthread_get_stack_usage(int tid);
+
+
+/**
+ * @brief Prints the stack high-water marks of all painted threads, grouped by entry point.
+ *
+ * Terminated threads are remembered by entry point (the first 64 entry points), live threads are scanned on the
+ * spot. For every entry point the report recommends a stack size class (a power of two with a quarter of headroom),
+ * followed by the size that would fit all of them.
+*/
+void uthread_stack_report();
+
+
+/**
+ * @brief Reads up to count bytes from fd into buf, parking only the calling thread while fd has no data.
+ *
+ * Behaves like read(2), except that when the read would block the calling thread moves to a waiting state and other
+ * threads keep running; the scheduler polls the fd (with epoll) whenever it switches threads or has nothing to run,
+ * and makes the thread READY again once fd is readable. A blocking fd stays blocking for everyone else: the mode
+ * belongs to the open file, which other processes may share, so it is non-blocking only while a call is being tried.
+ * Blocking a waiting thread with uthread_block takes effect when its wait is over.
+ * The first call to a libc function from a thread is resolved by the dynamic linker on that thread's stack, which
+ * alone can take most of STACK_SIZE; link programs that do I/O from threads with -Wl,-z,now.
+ *
+ * @return As read(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void *buf, size_t count);
+
+
+/**
+ * @brief Writes up to count bytes from buf to fd, parking only the calling thread while fd is not writable.
+ *
+ * See uthread_read for how the waiting is done.
+ *
+ * @return As write(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_write(int fd, const void *buf, size_t count);
+
+
+/**
+ * @brief Accepts a connection on the listening socket sockfd, parking only the calling thread until one arrives.
+ *
+ * See uthread_read for how the waiting is done. The accepted socket is returned as accept(2) creates it.
+ *
+ * @return As accept(2): the new socket, or -1 with errno set.
+*/
+int uthread_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+
+
+/**
+ * @brief Connects the socket sockfd to addr, parking only the calling thread until the connection is established.
+ *
+ * See uthread_read for how the waiting is done.
+ *
+ * @return As connect(2): 0 on success, or -1 with errno set.
+*/
+int uthread_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+
+
+/**
+ * @brief Waits for one of the fds to become ready, parking only the calling thread, for at most timeout milliseconds.
+ *
+ * Behaves like poll(2). While nothing is ready the calling thread waits on a private epoll instance holding the fds
+ * (and a timerfd for the timeout), which the scheduler watches like any fd given to uthread_read. Those two
+ * descriptors are closed when the call returns; terminating the thread while it waits leaks them.
+ *
+ * @return As poll(2): the number of fds with events, 0 on timeout, or -1 with errno set.
+*/
+int uthread_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+
+/**
+ * @brief Reads up to count bytes at offset of the file fd into buf, parking only the calling thread meanwhile.
+ *
+ * Behaves like pread(2), but the read is queued on an io_uring owned by the scheduler and the calling thread moves to
+ * a waiting state while other threads keep running. The requests of all threads made during one quantum are submitted
+ * together when it ends, or right away when no thread is left to run; completions are collected at every switch.
+ * Terminating a thread whose request is in flight waits for that request first, since the kernel may still be writing
+ * into its buffer. Without io_uring (older kernels, seccomp) the call is simply pread(2).
+ *
+ * @return As pread(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Writes up to count bytes from buf at offset of the file fd, parking only the calling thread meanwhile.
+ *
+ * See uthread_pread for how the waiting is done.
+ *
+ * @return As pwrite(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Flushes the file fd to its storage device, parking only the calling thread meanwhile.
+ *
+ * See uthread_pread for how the waiting is done.
+ *
+ * @return As fsync(2): 0 on success, or -1 with errno set.
+*/
+int uthread_fsync(int fd);
+
+
+/**
+ * @brief Tells whether the caller is a thread of this library that may park.
+ *
+ * That is the case once uthread_init was called, as long as the caller does not have the timer signal blocked, which
+ * the library itself, its scheduler and its signal handler always have. Used by the optional wrappers in
+ * uthreads_wrap.cpp to decide between parking and calling libc directly.
+ *
+ * @return 1 if the caller is such a thread, 0 otherwise.
+*/
+int uthread_in_thread();
+
+
+/**
+ * @brief Locks mutex, parking the RUNNING thread while another thread holds it.
+ *
+ * Waiters are woken highest priority first, in FIFO order among equals, and compete again for the mutex when they
+ * run; meanwhile the holder runs with the priority of the most urgent of them if it is higher than its own. Locking
+ * a mutex the RUNNING thread already holds is an error. A waiter parks at once and does not spin: spinning only pays
+ * while the holder runs at the same time elsewhere, and all threads of this library share one kernel thread.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Locks mutex if no thread holds it.
+ *
+ * @return If the mutex was locked by this call, return 0. Otherwise return -1.
+*/
+int uthread_mutex_trylock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Unlocks mutex and wakes its most urgent waiter, if any. Only the holder may unlock it.
+ *
+ * The holder drops the priority it inherited through mutex, and gives way at once if that leaves it outranked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Unlocks mutex and parks the RUNNING thread on cond, as one step; locks mutex again before returning.
+ *
+ * The RUNNING thread must hold mutex. As with any condition variable, callers should recheck their condition after
+ * waking up.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Wakes the longest waiting thread on cond, if any.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_signal(uthread_cond_t *cond);
+
+
+/**
+ * @brief Wakes all threads waiting on cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_broadcast(uthread_cond_t *cond);
+
+
+/**
+ * @brief Locks rwlock for reading, parking the RUNNING thread while a writer holds it or waits for it.
+ *
+ * Any number of readers hold it together. A writer waiting keeps new readers out, so writers are not starved by a
+ * stream of readers. Parked readers are let in all at once when the last writer unlocks.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_rdlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Locks rwlock for writing, parking the RUNNING thread while anybody else holds it.
+ *
+ * Waiting writers get it one at a time, in FIFO order, before any parked reader. The lock is handed over to the
+ * thread woken, so nobody can take it between the wake up and the time it runs; if that thread is terminated before
+ * it runs, the lock goes on as if it had unlocked it.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_rwlock_wrlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Unlocks rwlock, held by the RUNNING thread for reading or for writing.
+ *
+ * @return On success, return 0. On failure (it is not locked), return -1.
+*/
+int uthread_rwlock_unlock(uthread_rwlock_t *rwlock);
+
+
+/**
+ * @brief Initializes barrier for rounds of count threads.
+ *
+ * @return On success, return 0. On failure (count is not positive), return -1.
+*/
+int uthread_barrier_init(uthread_barrier_t *barrier, int count);
+
+
+/**
+ * @brief Parks the RUNNING thread until count threads, itself included, have called this on barrier in this round.
+ *
+ * The threads of a round wait on one queue, and the last to arrive releases them all at once: the whole queue goes
+ * to the end of the READY queue in one step, in arrival order, instead of each thread polling for its turn. The
+ * barrier is ready for the next round as soon as it is released.
+ *
+ * @return UTHREAD_BARRIER_SERIAL_THREAD for the last thread to arrive, 0 for the others, -1 on failure.
+*/
+int uthread_barrier_wait(uthread_barrier_t *barrier);
+
+
+/**
+ * @brief Initializes latch to be released after count count downs (at once if count is 0).
+ *
+ * @return On success, return 0. On failure (count is negative), return -1.
+*/
+int uthread_latch_init(uthread_latch_t *latch, int count);
+
+
+/**
+ * @brief Counts latch down by n; when it reaches zero, all its waiters are released at once, as by a barrier.
+ *
+ * Does not block.
+ *
+ * @return On success, return 0. On failure (n is not positive or larger than what is left), return -1.
+*/
+int uthread_latch_count_down(uthread_latch_t *latch, int n);
+
+
+/**
+ * @brief Parks the RUNNING thread until latch has been counted down to zero; returns at once if it has.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_latch_wait(uthread_latch_t *latch);
+
+
+/**
+ * @brief Parks the RUNNING thread on address, if *address still holds expected, until uthread_wake is called on it.
+ *
+ * The comparison and the park are one step as far as other threads of the library are concerned, so a thread that
+ * changes *address and then calls uthread_wake cannot be missed. Meant for data structures built on plain (or
+ * atomic) ints that want to park without knowing the ids of their waiters; address is only compared, never written,
+ * and the caller should check its condition again after waking.
+ *
+ * @return 0 once woken. -1 with errno set to EAGAIN if *address did not hold expected, and -1 on failure.
+*/
+int uthread_wait_on(const volatile int *address, int expected);
+
+
+/**
+ * @brief Wakes at most n threads parked by uthread_wait_on on address, the longest waiting first.
+ *
+ * @return The number of threads woken (0 if none waited), or -1 on failure (n is not positive).
+*/
+int uthread_wake(const volatile int *address, int n);
+
+
+/**
+ * @brief Initializes channel to hold up to capacity messages in slots, an array of capacity pointers.
+ *
+ * @return On success, return 0. On failure (no slots or capacity not positive), return -1.
+*/
+int uthread_channel_init(uthread_channel_t *channel, void **slots, int capacity);
+
+
+/**
+ * @brief Puts message at the end of channel, parking the RUNNING thread while the channel is full.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_channel_send(uthread_channel_t *channel, void *message);
+
+
+/**
+ * @brief Takes the oldest message off channel into *message, parking the RUNNING thread while the channel is empty.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_channel_receive(uthread_channel_t *channel, void **message);
+
+
+/**
+ * @brief Waits for the first of several events, and carries it out: a message to receive, room to send one, or an fd
+ * ready for reading or writing.
+ *
+ * If no case is ready at once, the RUNNING thread parks on the wait queues of all of them together. The first event
+ * wakes it and takes it off all the other queues there and then (a step per case), so a thread parked here is woken
+ * once; it then carries out the case that woke it, or, if another thread got there first, checks all of them again.
+ * When several cases are ready, the earliest one in cases is taken. No two cases may wait on the same queue (the same
+ * channel and direction, or the same fd and direction).
+ *
+ * @param timeout_usecs How long to wait at most: 0 only checks, and a negative value waits with no limit.
+ * @return The index of the case carried out. -1 with errno set to ETIMEDOUT if the timeout passed first, and -1 on
+ * failure.
+*/
+int uthread_select(uthread_select_case *cases, int amount, long timeout_usecs);
+
+
+/**
+ * @brief Creates a generator that will run body(arg) on a stack of its own of stack_size bytes (0 for STACK_SIZE).
+ *
+ * The body does not start until the first uthread_generator_resume. A generator is not a thread: it runs on the
+ * thread that resumes it, as part of it, and switching in and out of it is a direct jump with no scheduler pass, no
+ * ready queue and no system call. Any thread may resume it, one at a time. It may be called before uthread_init.
+ *
+ * @return The generator, or NULL on failure (no body, or a stack under 1024 bytes).
+*/
+uthread_generator_t *uthread_generator_create(uthread_generator_body body, void *arg, int stack_size);
+
+
+/**
+ * @brief Runs generator until its body calls uthread_yield_value or returns, and stores the value yielded to *value.
+ *
+ * A generator may resume another one; yielding then returns to the generator that resumed it.
+ *
+ * @return 1 if the body yielded a value, 0 if it returned (now or before), -1 on failure (the generator is running).
+*/
+int uthread_generator_resume(uthread_generator_t *generator, void **value);
+
+
+/**
+ * @brief Hands value to whoever resumed the generator running this body, and waits to be resumed again.
+ *
+ * @return On success (once resumed), return 0. On failure (not called from a generator's body), return -1.
+*/
+int uthread_yield_value(void *value);
+
+
+/**
+ * @brief Frees generator and its stack. One that has not finished is dropped where it last yielded, without
+ * unwinding its stack.
+ *
+ * @return On success, return 0. On failure (the generator is running), return -1.
+*/
+int uthread_generator_destroy(uthread_generator_t *generator);
+
+
+/**
+ * @brief Posts task(arg) to run to completion on the scheduler's own stack, between thread slices.
+ *
+ * A task is a plain function and argument: no thread, stack or context is made for it, and tasks run back to back,
+ * oldest first, with no switch between them. While threads are READY the tasks get the share of the CPU set by
+ * uthread_set_task_share; while none is, they run until none is left. A task runs with the tick blocked and on
+ * behalf of no thread, so it must be short, and must neither park nor use the calling thread (uthread_get_tid,
+ * mutexes, sleeping, blocking I/O); it may post tasks, send on a channel with room and wake threads. Tasks also run
+ * right after the tick preempts a thread, which may have stopped anywhere, inside malloc or stdio included, so a
+ * task keeps to what a signal handler may do: no malloc, new, free or delete (nor anything that allocates, such as
+ * growing a std::string), no stdio, only async-signal-safe libc calls. Posting blocks no signal and makes no system
+ * call, so threads and tasks may post as often as they like.
+ *
+ * @return On success, return 0. On failure (no task, or MAX_POSTED_TASKS are waiting), return -1.
+*/
+int uthread_post(thread_entry_point_arg task, void *arg);
+
+
+/**
+ * @brief Sets the percentage of the CPU posted tasks get while threads are READY (50 at first).
+ *
+ * Each thread slice earns the tasks the matching time to run before the next thread, and a task that overruns is
+ * paid back from the next slices. At 0 tasks only run while no thread is READY; at 100 they all run before the next
+ * thread does.
+ *
+ * @return On success, return 0. On failure (percent is not within 0 to 100), return -1.
+*/
+int uthread_set_task_share(int percent);
+
+
+/**
+ * @brief Creates an executor: workers threads that run the work submitted to it, with room for capacity items queued.
+ *
+ * The workers are spawned once and live until uthread_executor_shutdown, so running a unit of work costs no spawn, no
+ * stack and no thread id of its own, and any amount of work runs on a few ids. A worker with nothing to do parks
+ * until work is submitted. The workers cannot be terminated with uthread_terminate.
+ *
+ * @return The executor, or NULL on failure (workers or capacity not positive, or fewer free thread ids than workers).
+*/
+uthread_executor_t *uthread_executor_create(int workers, int capacity);
+
+
+/**
+ * @brief Queues work(arg) on executor, parking the RUNNING thread while the queue is full.
+ *
+ * Work runs in the order it was submitted, each on whichever worker is free. If future is not NULL it is reset once the
+ * work is queued, and gets work's return value when work returns; on failure it is left as it was. A worker
+ * submitting to its own full executor may wait forever.
+ *
+ * @return On success, return 0. On failure (no executor or work, or it is shutting down, also while waiting for room),
+ * return -1.
+*/
+int uthread_executor_submit(uthread_executor_t *executor, uthread_work_fn work, void *arg, uthread_future_t *future);
+
+
+/**
+ * @brief Parks the RUNNING thread until future is done, and stores its result to *result (unless result is NULL).
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_future_wait(uthread_future_t *future, void **result);
+
+
+/**
+ * @brief Lets executor run all the work queued on it, waits for its workers to end, and frees it.
+ *
+ * @return On success, return 0. On failure (no executor, or called by one of its workers), return -1.
+*/
+int uthread_executor_shutdown(uthread_executor_t *executor);
+
+
+/**
+ * @brief Creates an actor system: workers threads that run actors while they have messages, at most batch messages of
+ * an actor per activation.
+ *
+ * An actor takes no thread, stack or thread id: it is only its uthread_actor_t, so there may be millions of them on a
+ * few workers. An actor with messages is queued for the workers; a worker hands the oldest messages to its behavior
+ * in one batch, and queues it again behind the others if more are left. An actor runs on one worker at a time, so its
+ * behavior needs no lock for its state. Idle workers park until a message comes. The workers cannot be terminated
+ * with uthread_terminate.
+ *
+ * @return The system, or NULL on failure (workers or batch not positive, or fewer free thread ids than workers).
+*/
+uthread_actor_system_t *uthread_actor_system_create(int workers, int batch);
+
+
+/**
+ * @brief Sets up actor, with an empty mailbox, to run behavior on system. state is for the behavior, as actor->state.
+ *
+ * @return On success, return 0. On failure (no actor, system or behavior), return -1.
+*/
+int uthread_actor_init(uthread_actor_t *actor, uthread_actor_system_t *system, uthread_actor_fn behavior,
+                       void *state);
+
+
+/**
+ * @brief Adds message to the mailbox of actor, and queues the actor for a worker if it was not queued or running.
+ *
+ * Never parks: a mailbox has no bound. May be called from threads, tasks and behaviors. The message must stay as it
+ * is until the behavior has it; from then on it is the behavior's, which may send it on (after reading next).
+ *
+ * @return On success, return 0. On failure (no actor or message, or its system is ending its workers), return -1.
+ * Sending to an actor whose system has been shut down is undefined.
+*/
+int uthread_actor_send(uthread_actor_t *actor, uthread_message_t *message);
+
+
+/**
+ * @brief Waits until no actor of system has messages and none is running, then ends its workers and frees it.
+ *
+ * Behaviors may keep sending meanwhile. Sends fail while the workers end; once this returns the system is freed, and
+ * its actors must not be sent to or run again.
+ *
+ * @return On success, return 0. On failure (no system, or called by one of its workers), return -1.
+*/
+int uthread_actor_system_shutdown(uthread_actor_system_t *system);
+
+
 #endif
@@ -0,0 +1,264 @@
+/*
+ * Parallel algorithms over contiguous ranges, built on the fork-join
+ * primitives of uthreads.h (uthread_parallel_for). Header only: include it
+ * next to uthreads.h and call the algorithms from a thread of the library,
+ * the main thread included, after uthread_init.
+ *
+ * A range is cut into chunks of grain elements (by default about one per two
+ * thread ids, and never under UTHREAD_MIN_GRAIN), each chunk is a task, and
+ * below that the work is plain serial code written so the compiler can keep
+ * several independent streams in flight. The chunks run on STACK_SIZE stacks,
+ * so the element operations should use little stack. Scratch memory
+ * (partial results, the merge buffer of sort) is allocated by the caller.
+ */
+
+#ifndef _UTHREADS_ALGORITHMS_H
+#define _UTHREADS_ALGORITHMS_H
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include "uthreads.h"
+
+#define UTHREAD_MIN_GRAIN 4096 /* smallest chunk handed to a task by default */
+
+namespace uthread
+{
+
+namespace detail
+{
+
+inline long chunk_grain(long n, long grain)
+{
+    return grain > 0 ? grain : std::max(n / (MAX_THREAD_NUM / 2), (long) UTHREAD_MIN_GRAIN);
+}
+
+/* calls fn(i) for every i in 0..count-1, each as a task of its own while thread ids last */
+template<typename Fn>
+void for_each_index(long count, Fn &fn)
+{
+    struct adapter
+    {
+        static void run(long begin, long end, void *fn)
+        {
+            for (long i = begin; i < end; i++)
+            {
+                (*(Fn *) fn)(i);
+            }
+        }
+    };
+    uthread_parallel_for(0, count, 1, adapter::run, &fn);
+}
+
+/* folds data[0..n-1] (n > 0) in order, as four independent quarters combined at the end */
+template<typename T, typename BinaryOp>
+T fold(const T *data, long n, BinaryOp op)
+{
+    if (n < 8)
+    {
+        T sum = data[0];
+        for (long i = 1; i < n; i++)
+        {
+            sum = op(sum, data[i]);
+        }
+        return sum;
+    }
+    long quarter = n / 4;
+    const T *q1 = data + quarter, *q2 = data + 2 * quarter, *q3 = data + 3 * quarter;
+    T sum0 = data[0], sum1 = q1[0], sum2 = q2[0], sum3 = q3[0];
+    for (long i = 1; i < quarter; i++)
+    {
+        sum0 = op(sum0, data[i]);
+        sum1 = op(sum1, q1[i]);
+        sum2 = op(sum2, q2[i]);
+        sum3 = op(sum3, q3[i]);
+    }
+    for (long i = 4 * quarter; i < n; i++)
+    {
+        sum3 = op(sum3, data[i]);
+    }
+    return op(op(sum0, sum1), op(sum2, sum3));
+}
+
+/* merges two sorted runs into out, taking from the left one on ties; picks without a branch per element */
+template<typename T, typename Compare>
+void merge(const T *left, const T *left_end, const T *right, const T *right_end, T *out, Compare comp)
+{
+    while (left != left_end && right != right_end)
+    {
+        bool take_right = comp(*right, *left);
+        *out++ = take_right ? *right : *left;
+        right += take_right;
+        left += !take_right;
+    }
+    out = std::copy(left, left_end, out);
+    std::copy(right, right_end, out);
+}
+
+} // namespace detail
+
+
+/**
+ * @brief Stores op(first[i]) to d_first[i] for every element of first..last-1.
+ *
+ * @return d_first + (last - first)
+*/
+template<typename T, typename U, typename UnaryOp>
+U *transform(const T *first, const T *last, U *d_first, UnaryOp op, long grain = 0)
+{
+    long n = last - first;
+    grain = detail::chunk_grain(n, grain);
+    auto chunk = [&](long c)
+    {
+        long end = std::min((c + 1) * grain, n);
+        for (long i = c * grain; i < end; i++)
+        {
+            d_first[i] = op(first[i]);
+        }
+    };
+    detail::for_each_index((n + grain - 1) / grain, chunk);
+    return d_first + n;
+}
+
+
+/**
+ * @brief Returns init combined with every element of first..last-1 by op, which must be associative.
+ *
+ * The elements keep their order (op need not be commutative), but are grouped differently than a left fold.
+*/
+template<typename T, typename BinaryOp>
+T reduce(const T *first, const T *last, T init, BinaryOp op, long grain = 0)
+{
+    long n = last - first;
+    if (n <= 0)
+    {
+        return init;
+    }
+    grain = detail::chunk_grain(n, grain);
+    std::vector<T> partials((n + grain - 1) / grain);
+    auto chunk = [&](long c)
+    {
+        long begin = c * grain;
+        partials[c] = detail::fold(first + begin, std::min(begin + grain, n) - begin, op);
+    };
+    detail::for_each_index((long) partials.size(), chunk);
+    for (const T &partial : partials)
+    {
+        init = op(init, partial);
+    }
+    return init;
+}
+
+template<typename T>
+T reduce(const T *first, const T *last, T init)
+{
+    return reduce(first, last, init, std::plus<T>());
+}
+
+
+/**
+ * @brief Stores the prefix sums of first..last-1 by op (associative) to d_first: d_first[i] = first[0] op ... op first[i].
+ *
+ * Runs in three steps: the sum of each chunk in parallel, a serial scan over the chunk sums, and the scan of each
+ * chunk from its carry in parallel. d_first may be first.
+ *
+ * @return d_first + (last - first)
+*/
+template<typename T, typename BinaryOp>
+T *inclusive_scan(const T *first, const T *last, T *d_first, BinaryOp op, long grain = 0)
+{
+    long n = last - first;
+    if (n <= 0)
+    {
+        return d_first;
+    }
+    grain = detail::chunk_grain(n, grain);
+    long chunks = (n + grain - 1) / grain;
+    std::vector<T> carries(chunks); // the sum of everything before the chunk, from chunk 1 on
+    auto sum_chunk = [&](long c)
+    {
+        if (c + 1 < chunks)
+        {
+            carries[c + 1] = detail::fold(first + c * grain, grain, op);
+        }
+    };
+    detail::for_each_index(chunks, sum_chunk);
+    for (long c = 2; c < chunks; c++)
+    {
+        carries[c] = op(carries[c - 1], carries[c]);
+    }
+    auto scan_chunk = [&](long c)
+    {
+        long begin = c * grain, end = std::min(begin + grain, n);
+        T sum = c > 0 ? op(carries[c], first[begin]) : first[begin];
+        d_first[begin] = sum;
+        for (long i = begin + 1; i < end; i++)
+        {
+            sum = op(sum, first[i]);
+            d_first[i] = sum;
+        }
+    };
+    detail::for_each_index(chunks, scan_chunk);
+    return d_first + n;
+}
+
+template<typename T>
+T *inclusive_scan(const T *first, const T *last, T *d_first)
+{
+    return inclusive_scan(first, last, d_first, std::plus<T>());
+}
+
+
+/**
+ * @brief Sorts first..last-1 by comp (not stably).
+ *
+ * Each chunk is sorted by std::sort as a task, then the sorted runs are merged pairwise, a pass per doubling of the
+ * run length and every pair of a pass as a task, through a scratch buffer as large as the range.
+*/
+template<typename T, typename Compare>
+void sort(T *first, T *last, Compare comp, long grain = 0)
+{
+    long n = last - first;
+    if (n < 2)
+    {
+        return;
+    }
+    grain = detail::chunk_grain(n, grain);
+    auto sort_chunk = [&](long c)
+    {
+        std::sort(first + c * grain, first + std::min((c + 1) * grain, n), comp);
+    };
+    detail::for_each_index((n + grain - 1) / grain, sort_chunk);
+    if (grain >= n)
+    {
+        return;
+    }
+
+    std::vector<T> scratch(n);
+    T *from = first, *to = scratch.data();
+    for (long width = grain; width < n; width *= 2)
+    {
+        auto merge_pair = [&](long p)
+        {
+            long begin = p * 2 * width;
+            long middle = std::min(begin + width, n), end = std::min(begin + 2 * width, n);
+            detail::merge(from + begin, from + middle, from + middle, from + end, to + begin, comp);
+        };
+        detail::for_each_index((n + 2 * width - 1) / (2 * width), merge_pair);
+        std::swap(from, to);
+    }
+    if (from != first)
+    {
+        std::copy(from, from + n, first);
+    }
+}
+
+template<typename T>
+void sort(T *first, T *last)
+{
+    sort(first, last, std::less<T>());
+}
+
+} // namespace uthread
+
+#endif
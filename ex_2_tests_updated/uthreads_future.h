@@ -0,0 +1,292 @@
+/*
+ * Typed futures and promises for threads of uthreads.h. Header only: include
+ * it next to uthreads.h and use it from threads of the library, after
+ * uthread_init.
+ *
+ * A promise holds its value in place, so setting and getting one allocates
+ * nothing, whatever the type; its future is a handle to it and may be copied
+ * freely, but is only good while the promise lives. Waiting parks on the
+ * promise through uthread_wait_on, and setting the value moves every waiter
+ * to the READY queue at once with uthread_wake. A continuation added with
+ * then() runs as a posted task (uthread_post) once the value is there, and
+ * its own result goes to a promise the continuation carries along: only
+ * then() allocates, one node that the first promise frees when it ends. A
+ * promise ending before its continuation has run waits for it, since the
+ * continuation reads the value in place; tasks may not free the node
+ * themselves (see uthread_post).
+ */
+
+#ifndef _UTHREADS_FUTURE_H
+#define _UTHREADS_FUTURE_H
+
+#include <climits>
+#include <cstdio>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "uthreads.h"
+
+namespace uthread
+{
+
+template<typename T> class promise;
+
+namespace detail
+{
+
+/* what f returns for a const T & */
+template<typename F, typename T>
+using result_of = typename std::decay<decltype(std::declval<F &>()(std::declval<const T &>()))>::type;
+
+/* something to run once a promise has its value; it runs on the scheduler's stack */
+struct continuation
+{
+    continuation() : done(0) {}
+    virtual void run() = 0;
+    virtual ~continuation() {}
+
+    volatile int done; // 1 once run() has returned
+};
+
+/* marks a promise that has its value but no continuation yet */
+inline continuation *fired()
+{
+    static struct : continuation
+    {
+        void run() {}
+    } mark;
+    return &mark;
+}
+
+/* marks a promise whose continuation was handed to the scheduler, by whoever swapped this in */
+inline continuation *started()
+{
+    static struct : continuation
+    {
+        void run() {}
+    } mark;
+    return &mark;
+}
+
+inline void run_continuation(void *next)
+{
+    continuation *self = (continuation *) next;
+    self->run();
+    __atomic_store_n(&self->done, 1, __ATOMIC_RELEASE);
+    uthread_wake(&self->done, INT_MAX);
+}
+
+/* hands a continuation to the scheduler, or runs it in place if the task queue is full */
+inline void start(continuation *next)
+{
+    if (uthread_post(run_continuation, next) != 0)
+    {
+        run_continuation(next);
+    }
+}
+
+} // namespace detail
+
+
+/**
+ * @brief A handle to the value a promise will get. Copies refer to the same promise.
+*/
+template<typename T>
+class future
+{
+public:
+    future() : promise_(nullptr) {}
+
+    /**
+     * @brief Whether it belongs to a promise.
+    */
+    bool valid() const
+    {
+        return promise_ != nullptr;
+    }
+
+    /**
+     * @brief Whether the promise has its value, so that get() will not park.
+    */
+    bool ready() const
+    {
+        return promise_->ready();
+    }
+
+    /**
+     * @brief Parks the RUNNING thread until the promise has its value, and returns it. Not to be called from a task.
+    */
+    const T &get() const
+    {
+        return promise_->wait();
+    }
+
+    /**
+     * @brief Runs f(value) as a posted task once the promise has its value (at once if it has), and returns a
+     * future for what f returns.
+     *
+     * A promise takes one continuation; the returned future is good while this future's promise lives. f runs on
+     * the scheduler's stack, with the rules of uthread_post: it must not park or allocate, and neither may moving
+     * what it returns.
+    */
+    template<typename F>
+    future<detail::result_of<F, T>> then(F f) const
+    {
+        return promise_->then(std::move(f));
+    }
+
+private:
+    friend class promise<T>;
+
+    explicit future(promise<T> *owner) : promise_(owner) {}
+
+    promise<T> *promise_;
+};
+
+
+/**
+ * @brief A value one thread (or task) sets once and others wait for, through future().
+ *
+ * Not copyable or movable, since its futures point at it. Destroying one whose continuation was started but has not
+ * run yet parks the RUNNING thread until it has, so that is not to be done from a task.
+*/
+template<typename T>
+class promise
+{
+    static_assert(!std::is_void<T>::value, "a promise holds a value");
+
+public:
+    promise() : status_(EMPTY), continuation_(nullptr), ran_(nullptr) {}
+
+    promise(const promise &) = delete;
+    promise &operator=(const promise &) = delete;
+
+    ~promise()
+    {
+        detail::continuation *next = continuation_;
+        if (next != nullptr && next != detail::fired() && next != detail::started())
+        {
+            delete next; // added, never run
+        }
+        if (ran_ != nullptr)
+        {
+            // it reads value() and lives in ran_: both have to outlast it
+            while (__atomic_load_n(&ran_->done, __ATOMIC_ACQUIRE) == 0)
+            {
+                uthread_wait_on(&ran_->done, 0);
+            }
+            delete ran_;
+        }
+        if (status_ == READY)
+        {
+            value().~T();
+        }
+    }
+
+    future<T> get_future()
+    {
+        return future<T>(this);
+    }
+
+    /**
+     * @brief Stores value, wakes every thread waiting for it and starts the continuation, if there is one.
+     *
+     * @return On success, return 0. On failure (the value was set before), return -1.
+    */
+    int set_value(T value)
+    {
+        if (status_ != EMPTY)
+        {
+            fprintf(stderr, "thread library error: the promise already has a value\n");
+            return -1;
+        }
+        new (&storage_) T(std::move(value));
+        __atomic_store_n(&status_, READY, __ATOMIC_RELEASE);
+        uthread_wake(&status_, INT_MAX);
+        // continuation_ alone decides who starts a continuation: then() may be adding one meanwhile
+        detail::continuation *next = nullptr;
+        while (!__atomic_compare_exchange_n(&continuation_, &next,
+                                            next == nullptr ? detail::fired() : detail::started(), false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {}
+        if (next != nullptr)
+        {
+            ran_ = next;
+            detail::start(next);
+        }
+        return 0;
+    }
+
+private:
+    friend class future<T>;
+
+    enum { EMPTY, READY };
+
+    template<typename F, typename U>
+    struct continuation_of : detail::continuation
+    {
+        continuation_of(F f, promise<T> *source) : f(std::move(f)), source(source) {}
+
+        void run()
+        {
+            next.set_value(f(source->value()));
+        }
+
+        F f;
+        promise<T> *source;
+        promise<U> next;
+    };
+
+    bool ready() const
+    {
+        return __atomic_load_n(&status_, __ATOMIC_ACQUIRE) == READY;
+    }
+
+    T &value()
+    {
+        return *reinterpret_cast<T *>(&storage_);
+    }
+
+    const T &wait()
+    {
+        while (!ready())
+        {
+            uthread_wait_on(&status_, EMPTY);
+        }
+        return value();
+    }
+
+    template<typename F>
+    future<detail::result_of<F, T>> then(F f)
+    {
+        typedef detail::result_of<F, T> U;
+        continuation_of<F, U> *next = new continuation_of<F, U>(std::move(f), this);
+        detail::continuation *expected = nullptr;
+        if (!__atomic_compare_exchange_n(&continuation_, &expected, (detail::continuation *) next, false,
+                                         __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            // the value came first: only the one that swaps fired() for started() starts its continuation
+            if (expected != detail::fired()
+                || !__atomic_compare_exchange_n(&continuation_, &expected, detail::started(), false,
+                                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            {
+                fprintf(stderr, "thread library error: the promise already has a continuation\n");
+                delete next;
+                return future<U>();
+            }
+            ran_ = next;
+            detail::start(next);
+        }
+        return next->next.get_future();
+    }
+
+    volatile int status_;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_;
+    // added by then(); detail::fired() once the value is set, detail::started() once a continuation was started
+    detail::continuation *continuation_;
+    detail::continuation *ran_; // the one started, written only by whoever swapped in started(); freed with the promise
+};
+
+} // namespace uthread
+
+#endif
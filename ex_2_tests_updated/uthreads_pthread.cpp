@@ -0,0 +1,499 @@
+/*
+ * Optional pthread shim: link this file into a program next to uthreads.cpp
+ * (adding -ldl on older glibc) and the common subset of pthreads below runs
+ * on uthreads instead of kernel threads, without touching the program's
+ * sources: pthread_create/join/detach/exit/self, mutexes, condition
+ * variables, pthread_once and thread specific keys. The first pthread_create
+ * initializes the library with a quantum of SHIM_QUANTUM_USECS.
+ *
+ * Run the program with UTHREADS_PTHREAD_SHIM=0 in its environment to send
+ * every one of these calls to the real pthreads instead, e.g. to measure what
+ * the shim gains.
+ *
+ * Limits: a thread gets STACK_SIZE bytes of stack whatever its attributes
+ * ask for, and of the attributes only the detach state is honored; mutexes
+ * are never recursive, and whatever their type they park like a plain one;
+ * at most MAX_THREAD_NUM - 1 threads exist at a time, pthread_create says
+ * EAGAIN beyond that. pthread functions outside the subset must not be
+ * given the shim's threads, mutexes or conditions.
+ */
+
+#include <dlfcn.h>
+#include <pthread.h>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "uthreads.h"
+
+#define SHIM_QUANTUM_USECS 10000
+#define SHIM_KEYS_MAX 64 /* thread specific keys that can exist at a time */
+
+static_assert (sizeof (uthread_mutex_t) <= sizeof (pthread_mutex_t),
+               "a uthread mutex has to fit in a pthread_mutex_t");
+static_assert (sizeof (uthread_cond_t) <= sizeof (pthread_cond_t),
+               "a uthread condition has to fit in a pthread_cond_t");
+
+/*
+ * The libc versions, for when the shim is switched off. The choice is made
+ * once, by the first call that reaches the shim. Everything of the shim but
+ * the pthread functions is static, so it cannot clash with the program's
+ * own names.
+ */
+#define REAL(function) static decltype (&function) real_##function = nullptr
+#define RESOLVE(function) \
+  real_##function = (decltype (real_##function)) dlsym (RTLD_NEXT, #function)
+
+REAL (pthread_create);
+REAL (pthread_join);
+REAL (pthread_detach);
+REAL (pthread_exit);
+REAL (pthread_self);
+REAL (pthread_mutex_init);
+REAL (pthread_mutex_destroy);
+REAL (pthread_mutex_lock);
+REAL (pthread_mutex_trylock);
+REAL (pthread_mutex_unlock);
+REAL (pthread_cond_init);
+REAL (pthread_cond_destroy);
+REAL (pthread_cond_wait);
+REAL (pthread_cond_signal);
+REAL (pthread_cond_broadcast);
+REAL (pthread_once);
+REAL (pthread_key_create);
+REAL (pthread_key_delete);
+REAL (pthread_getspecific);
+REAL (pthread_setspecific);
+
+static int shim_state = -1; // 1 when the shim is used, 0 when libc is; -1 until known
+
+/**
+ * a pthread as the shim sees it; pthread_t is a pointer to one of these.
+ */
+struct shim_thread
+{
+  int tid;
+  void *(*start_routine) (void *);
+  void *arg;
+  void *result;
+  bool finished;
+  bool detached; // the record is freed by the thread itself when it exits
+  uthread_cond_t done;
+  void *specific[SHIM_KEYS_MAX];
+};
+
+static shim_thread main_thread = {};
+static shim_thread *threads[MAX_THREAD_NUM] = {&main_thread}; // by tid
+static bool initialized = false;
+static int live_threads = 0; // created and not exited yet, main not counted
+
+// guards everything above and below, and every pthread_once_t
+static uthread_mutex_t shim_lock = UTHREAD_MUTEX_INITIALIZER;
+static uthread_cond_t all_exited = UTHREAD_COND_INITIALIZER;
+static uthread_cond_t once_done = UTHREAD_COND_INITIALIZER;
+
+static bool key_used[SHIM_KEYS_MAX];
+static void (*key_destructors[SHIM_KEYS_MAX]) (void *);
+
+static bool shim_enabled ()
+{
+  if (shim_state == -1)
+  {
+    const char *flag = getenv ("UTHREADS_PTHREAD_SHIM");
+    shim_state = flag == nullptr || strcmp (flag, "0") != 0;
+    if (!shim_state)
+    {
+      RESOLVE (pthread_create);
+      RESOLVE (pthread_join);
+      RESOLVE (pthread_detach);
+      RESOLVE (pthread_exit);
+      RESOLVE (pthread_self);
+      RESOLVE (pthread_mutex_init);
+      RESOLVE (pthread_mutex_destroy);
+      RESOLVE (pthread_mutex_lock);
+      RESOLVE (pthread_mutex_trylock);
+      RESOLVE (pthread_mutex_unlock);
+      RESOLVE (pthread_cond_init);
+      RESOLVE (pthread_cond_destroy);
+      RESOLVE (pthread_cond_wait);
+      RESOLVE (pthread_cond_signal);
+      RESOLVE (pthread_cond_broadcast);
+      RESOLVE (pthread_once);
+      RESOLVE (pthread_key_create);
+      RESOLVE (pthread_key_delete);
+      RESOLVE (pthread_getspecific);
+      RESOLVE (pthread_setspecific);
+    }
+  }
+  return shim_state;
+}
+
+static shim_thread *current_thread ()
+{
+  shim_thread *self = threads[uthread_get_tid ()];
+  return self != nullptr ? self : &main_thread;
+}
+
+/**
+ * calls the destructors of the thread specific values of self, as often as
+ * they keep setting new ones (up to PTHREAD_DESTRUCTOR_ITERATIONS rounds).
+ */
+static void run_key_destructors (shim_thread *self)
+{
+  for (int round = 0; round < PTHREAD_DESTRUCTOR_ITERATIONS; round++)
+  {
+    bool called = false;
+    for (int key = 0; key < SHIM_KEYS_MAX; key++)
+    {
+      void *value = self->specific[key];
+      if (value == nullptr || !key_used[key] || key_destructors[key] == nullptr)
+      {
+        continue;
+      }
+      self->specific[key] = nullptr;
+      key_destructors[key] (value);
+      called = true;
+    }
+    if (!called)
+    {
+      return;
+    }
+  }
+}
+
+/**
+ * entry point of every thread the shim creates.
+ */
+static void shim_main (void *arg)
+{
+  shim_thread *self = (shim_thread *) arg;
+  threads[uthread_get_tid ()] = self; // pthread_create may not be back yet
+  pthread_exit (self->start_routine (self->arg));
+}
+
+extern "C" int pthread_create (pthread_t *thread, const pthread_attr_t *attr,
+                               void *(*start_routine) (void *), void *arg)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_create (thread, attr, start_routine, arg);
+  }
+  if (!initialized)
+  {
+    uthread_init (SHIM_QUANTUM_USECS);
+    initialized = true;
+  }
+  int detach_state = PTHREAD_CREATE_JOINABLE;
+  if (attr != nullptr)
+  {
+    pthread_attr_getdetachstate (attr, &detach_state);
+  }
+  shim_thread *record = new shim_thread ();
+  record->start_routine = start_routine;
+  record->arg = arg;
+  record->detached = detach_state == PTHREAD_CREATE_DETACHED;
+
+  uthread_mutex_lock (&shim_lock);
+  int tid = uthread_spawn_arg (shim_main, record);
+  if (tid < 0)
+  {
+    uthread_mutex_unlock (&shim_lock);
+    delete record;
+    return EAGAIN;
+  }
+  record->tid = tid;
+  threads[tid] = record;
+  live_threads++;
+  uthread_mutex_unlock (&shim_lock);
+  *thread = (pthread_t) record;
+  return 0;
+}
+
+extern "C" int pthread_join (pthread_t thread, void **retval)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_join (thread, retval);
+  }
+  shim_thread *target = (shim_thread *) thread;
+  if (target == current_thread () || target == &main_thread)
+  {
+    return EDEADLK;
+  }
+  uthread_mutex_lock (&shim_lock);
+  if (target->detached)
+  {
+    uthread_mutex_unlock (&shim_lock);
+    return EINVAL;
+  }
+  while (!target->finished)
+  {
+    uthread_cond_wait (&target->done, &shim_lock);
+  }
+  if (retval != nullptr)
+  {
+    *retval = target->result;
+  }
+  uthread_mutex_unlock (&shim_lock);
+  delete target;
+  return 0;
+}
+
+extern "C" int pthread_detach (pthread_t thread)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_detach (thread);
+  }
+  shim_thread *target = (shim_thread *) thread;
+  uthread_mutex_lock (&shim_lock);
+  bool finished = target->finished;
+  target->detached = true;
+  uthread_mutex_unlock (&shim_lock);
+  if (finished)
+  {
+    delete target;
+  }
+  return 0;
+}
+
+extern "C" void pthread_exit (void *retval)
+{
+  if (!shim_enabled ())
+  {
+    real_pthread_exit (retval);
+  }
+  shim_thread *self = current_thread ();
+  run_key_destructors (self);
+  uthread_mutex_lock (&shim_lock);
+  if (self == &main_thread)
+  {
+    // as with pthreads, the process goes on until the last thread exits
+    while (live_threads > 0)
+    {
+      uthread_cond_wait (&all_exited, &shim_lock);
+    }
+    exit (0);
+  }
+  int tid = self->tid;
+  threads[tid] = nullptr;
+  live_threads--;
+  uthread_cond_broadcast (&all_exited);
+  if (self->detached)
+  {
+    delete self;
+  }
+  else
+  {
+    self->result = retval;
+    self->finished = true;
+    uthread_cond_broadcast (&self->done);
+  }
+  uthread_mutex_unlock (&shim_lock);
+  uthread_terminate (tid);
+  __builtin_unreachable (); // terminating the running thread never returns
+}
+
+extern "C" pthread_t pthread_self ()
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_self ();
+  }
+  return (pthread_t) current_thread ();
+}
+
+extern "C" int pthread_mutex_init (pthread_mutex_t *mutex,
+                                   const pthread_mutexattr_t *attr)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_mutex_init (mutex, attr);
+  }
+  *(uthread_mutex_t *) mutex = UTHREAD_MUTEX_INITIALIZER;
+  return 0;
+}
+
+extern "C" int pthread_mutex_destroy (pthread_mutex_t *mutex)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_mutex_destroy (mutex);
+  }
+  return ((uthread_mutex_t *) mutex)->locked ? EBUSY : 0;
+}
+
+extern "C" int pthread_mutex_lock (pthread_mutex_t *mutex)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_mutex_lock (mutex);
+  }
+  return uthread_mutex_lock ((uthread_mutex_t *) mutex) == 0 ? 0 : EDEADLK;
+}
+
+extern "C" int pthread_mutex_trylock (pthread_mutex_t *mutex)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_mutex_trylock (mutex);
+  }
+  return uthread_mutex_trylock ((uthread_mutex_t *) mutex) == 0 ? 0 : EBUSY;
+}
+
+extern "C" int pthread_mutex_unlock (pthread_mutex_t *mutex)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_mutex_unlock (mutex);
+  }
+  return uthread_mutex_unlock ((uthread_mutex_t *) mutex) == 0 ? 0 : EPERM;
+}
+
+extern "C" int pthread_cond_init (pthread_cond_t *cond,
+                                  const pthread_condattr_t *attr)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_cond_init (cond, attr);
+  }
+  *(uthread_cond_t *) cond = UTHREAD_COND_INITIALIZER;
+  return 0;
+}
+
+extern "C" int pthread_cond_destroy (pthread_cond_t *cond)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_cond_destroy (cond);
+  }
+  return ((uthread_cond_t *) cond)->waiters.head != nullptr ? EBUSY : 0;
+}
+
+extern "C" int pthread_cond_wait (pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_cond_wait (cond, mutex);
+  }
+  return uthread_cond_wait ((uthread_cond_t *) cond,
+                            (uthread_mutex_t *) mutex) == 0 ? 0 : EPERM;
+}
+
+extern "C" int pthread_cond_signal (pthread_cond_t *cond)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_cond_signal (cond);
+  }
+  uthread_cond_signal ((uthread_cond_t *) cond);
+  return 0;
+}
+
+extern "C" int pthread_cond_broadcast (pthread_cond_t *cond)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_cond_broadcast (cond);
+  }
+  uthread_cond_broadcast ((uthread_cond_t *) cond);
+  return 0;
+}
+
+extern "C" int pthread_once (pthread_once_t *once_control,
+                             void (*init_routine) ())
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_once (once_control, init_routine);
+  }
+  // PTHREAD_ONCE_INIT is 0; 1 while init_routine runs, 2 once it returned
+  uthread_mutex_lock (&shim_lock);
+  while (*once_control == 1)
+  {
+    uthread_cond_wait (&once_done, &shim_lock);
+  }
+  if (*once_control == 2)
+  {
+    uthread_mutex_unlock (&shim_lock);
+    return 0;
+  }
+  *once_control = 1;
+  uthread_mutex_unlock (&shim_lock);
+  init_routine ();
+  uthread_mutex_lock (&shim_lock);
+  *once_control = 2;
+  uthread_cond_broadcast (&once_done);
+  uthread_mutex_unlock (&shim_lock);
+  return 0;
+}
+
+extern "C" int pthread_key_create (pthread_key_t *key,
+                                   void (*destructor) (void *))
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_key_create (key, destructor);
+  }
+  uthread_mutex_lock (&shim_lock);
+  for (int i = 0; i < SHIM_KEYS_MAX; i++)
+  {
+    if (!key_used[i])
+    {
+      key_used[i] = true;
+      key_destructors[i] = destructor;
+      for (shim_thread *thread: threads)
+      {
+        if (thread != nullptr)
+        {
+          thread->specific[i] = nullptr; // left over from a deleted key
+        }
+      }
+      uthread_mutex_unlock (&shim_lock);
+      *key = (pthread_key_t) i;
+      return 0;
+    }
+  }
+  uthread_mutex_unlock (&shim_lock);
+  return EAGAIN;
+}
+
+extern "C" int pthread_key_delete (pthread_key_t key)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_key_delete (key);
+  }
+  uthread_mutex_lock (&shim_lock);
+  if (key >= SHIM_KEYS_MAX || !key_used[key])
+  {
+    uthread_mutex_unlock (&shim_lock);
+    return EINVAL;
+  }
+  key_used[key] = false;
+  uthread_mutex_unlock (&shim_lock);
+  return 0;
+}
+
+extern "C" void *pthread_getspecific (pthread_key_t key)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_getspecific (key);
+  }
+  return key < SHIM_KEYS_MAX ? current_thread ()->specific[key] : nullptr;
+}
+
+extern "C" int pthread_setspecific (pthread_key_t key, const void *value)
+{
+  if (!shim_enabled ())
+  {
+    return real_pthread_setspecific (key, value);
+  }
+  if (key >= SHIM_KEYS_MAX || !key_used[key])
+  {
+    return EINVAL;
+  }
+  current_thread ()->specific[key] = (void *) value;
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Optional wrappers that make plain blocking calls cooperate with the
+ * scheduler, for code that was not written against uthreads.h.
+ *
+ * Link this file into the program next to uthreads.cpp (adding -ldl on older
+ * glibc), or build both into the shared object that provides the uthread API
+ * and LD_PRELOAD it. When called from a thread of the library, read, write,
+ * poll, nanosleep and usleep then park only that thread; from anywhere else
+ * (before uthread_init, from within the library or a signal handler) they go
+ * straight to libc. Calls libc makes internally (printf writing to stdout, for
+ * one) are not affected.
+ */
+
+#include <dlfcn.h>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <poll.h>
+#include "uthreads.h"
+
+typedef ssize_t (*read_function) (int, void *, size_t);
+typedef ssize_t (*write_function) (int, const void *, size_t);
+typedef int (*poll_function) (struct pollfd *, nfds_t, int);
+typedef int (*nanosleep_function) (const struct timespec *, struct timespec *);
+typedef int (*usleep_function) (useconds_t);
+
+read_function real_read = nullptr;
+write_function real_write = nullptr;
+poll_function real_poll = nullptr;
+nanosleep_function real_nanosleep = nullptr;
+usleep_function real_usleep = nullptr;
+
+/**
+ * looks up the libc versions before main: dlsym needs far more stack than a
+ * thread has.
+ */
+__attribute__((constructor)) void resolve_real_functions ()
+{
+  real_read = (read_function) dlsym (RTLD_NEXT, "read");
+  real_write = (write_function) dlsym (RTLD_NEXT, "write");
+  real_poll = (poll_function) dlsym (RTLD_NEXT, "poll");
+  real_nanosleep = (nanosleep_function) dlsym (RTLD_NEXT, "nanosleep");
+  real_usleep = (usleep_function) dlsym (RTLD_NEXT, "usleep");
+}
+
+extern "C" ssize_t read (int fd, void *buf, size_t count)
+{
+  if (!uthread_in_thread ())
+  {
+    return real_read (fd, buf, count);
+  }
+  return uthread_read (fd, buf, count);
+}
+
+extern "C" ssize_t write (int fd, const void *buf, size_t count)
+{
+  if (!uthread_in_thread ())
+  {
+    return real_write (fd, buf, count);
+  }
+  return uthread_write (fd, buf, count);
+}
+
+extern "C" int poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  if (!uthread_in_thread ())
+  {
+    return real_poll (fds, nfds, timeout);
+  }
+  return uthread_poll (fds, nfds, timeout);
+}
+
+extern "C" int nanosleep (const struct timespec *req, struct timespec *rem)
+{
+  if (!uthread_in_thread () || req == nullptr || req->tv_nsec < 0
+      || req->tv_nsec >= 1000000000L || req->tv_sec < 0)
+  {
+    return real_nanosleep (req, rem); // also reports the bad arguments
+  }
+  timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  uthread_sleep_until ((now.tv_sec + req->tv_sec) * 1000000000LL
+                       + now.tv_nsec + req->tv_nsec);
+  if (rem != nullptr)
+  {
+    rem->tv_sec = 0;
+    rem->tv_nsec = 0;
+  }
+  return 0;
+}
+
+extern "C" int usleep (useconds_t usec)
+{
+  if (!uthread_in_thread ())
+  {
+    return real_usleep (usec);
+  }
+  uthread_sleep_us (usec);
+  return 0;
+}